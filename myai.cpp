@@ -2,14 +2,20 @@
 #include <cassert>
 #include <set>
 #include <map>
+#include <new>
 #include <chrono>
+#include <memory>
 #include <vector>
 #include <string>
 #include <random>
 #include <fstream>
 #include <typeinfo>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 #include <exception>
 #include <algorithm>
+#include <functional>
 #include <unordered_map>
 #include "sdk.h"
 #include "const.h"
@@ -40,30 +46,157 @@ namespace RD_NAMESPACE {
 #endif
     
 /********************************/
-/*     Cacher                   */
+/*     Memo                     */
 /********************************/
 
-// adapt to different `this`, but not supporting parameter    
+// Per-round memoization table, indexed by dense keys (unit id, or Group::memo_key()).
+// Every table is invalidated at once by memo_new_round(), which Conductor::init calls,
+// so stale slots are dropped lazily. Optional int parameter for methods with arguments
 
-#ifdef CACHE_BEGIN
-    #error CACHE_BEGIN defined
-#endif
-#ifdef CACHE_END
-    #error CACHE_END defined
-#endif
+static unsigned memoEpoch = 1;
+static int memoGroupKeyCnt = 0;
 
-#define CACHE_BEGIN(type)     static std::unordered_map<const void*,type> cached_value_;     static int cached_round_ = -1, cached_camp_ = -1;     if (console->round() != cached_round_ || console->camp() != cached_camp_)     {         cached_round_ = console->round();         cached_camp_ = console->camp();         cached_value_.clear();     }     if (cached_value_.count(this))         return cached_value_[this];
+inline void memo_new_round()
+{
+    memoEpoch++;
+    memoGroupKeyCnt = 0;
+}
 
-#define CACHE_END(ret)     return cached_value_[this] = (ret);
+struct MemoStat
+{
+    static MemoStat *head; // all stats, as a linked list
+
+    const char *name;
+    long long hit, miss;
+    MemoStat *next;
+
+    MemoStat(const char *_name) : name(_name), hit(0), miss(0), next(head) { head = this; }
+};
+
+MemoStat *MemoStat::head = 0;
+
+template <class T>
+class Memo
+{
+    struct Slot
+    {
+        unsigned epoch;
+        std::vector<std::pair<int, T> > val; // (param, value)
+        Slot() : epoch(0) {}
+    };
+
+    std::vector<Slot> slots;
+    MemoStat stat;
+
+public:
+    explicit Memo(const char *name) : stat(name) {}
+    Memo(const Memo<T> &) = delete;
+    Memo<T> &operator=(const Memo<T> &) = delete;
+
+    // NULL if missed
+    const T *find(int key, int param = 0)
+    {
+        assert(key >= 0);
+        if (key < (int)slots.size() && slots[key].epoch == memoEpoch)
+            for (const auto &x : slots[key].val)
+                if (x.first == param)
+                {
+                    stat.hit++;
+                    return &x.second;
+                }
+        stat.miss++;
+        return NULL;
+    }
+
+    T store(int key, const T &value) { return store(key, 0, value); }
+
+    T store(int key, int param, const T &value)
+    {
+        if (key >= (int)slots.size())
+            slots.resize(key + 1);
+        Slot &slot = slots[key];
+        if (slot.epoch != memoEpoch)
+            slot.epoch = memoEpoch, slot.val.clear();
+        slot.val.push_back(std::make_pair(param, value));
+        return value;
+    }
+};
 
-// DO NOT USE BACKSLASH
 
 /********************************/
 /*     Logger                   */
 /********************************/
 
+// each category is a bit of RD_LOG_MASK
+enum LogCategory
+{
+    LOG_ROUND, // Round, Camp, RandomSeed, TimeConsumed
+    LOG_ERROR, // caught exceptions
+    LOG_WARNING,
+    LOG_UNIT_STATUS,
+    LOG_UNIT_ACTION,
+    LOG_GROUP_MEMBER,
+    LOG_GROUP_STATUS,
+    LOG_GROUP_ACTION,
+    LOG_MAP_STATUS,
+    LOG_MINE_STATUS,
+    LOG_BASE_STATUS,
+    LOG_MEMO_STATUS
+};
+
+// define RD_LOG_MASK to pick the categories at compile time, e.g. -DRD_LOG_MASK="(1<<LOG_ROUND|1<<LOG_ERROR)"
+#ifndef RD_LOG_MASK
+#ifdef RD_LOG_FILE
+#define RD_LOG_MASK (~0u)
+#else
+#define RD_LOG_MASK 0u
+#endif // RD_LOG_FILE
+#endif // RD_LOG_MASK
+
+inline constexpr bool log_on(LogCategory c) { return (RD_LOG_MASK) >> c & 1u; }
+
+// RD_LOG(LOG_UNIT_ACTION) << ... << '\n'; doesn't evaluate its arguments when the category is masked out
+// DO NOT USE BACKSLASH
+#define RD_LOG(category) if (! log_on(category)) ; else mylog
+
 #ifdef RD_LOG_FILE
-    std::ofstream mylog(LOG_FILE_NAME);
+    // one round of log in memory, written out by flush_log at the end of player_ai
+    class RoundLogBuffer : public std::streambuf
+    {
+    public:
+        RoundLogBuffer() { data.reserve(1 << 16); }
+
+        void flush_to(std::ofstream &os)
+        {
+            if (data.empty()) return;
+            os.write(data.data(), data.size());
+            os.flush();
+            data.clear();
+        }
+
+    protected:
+        int overflow(int c)
+        {
+            if (c != EOF) data.push_back(char(c));
+            return c;
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize n)
+        {
+            data.insert(data.end(), s, s + n);
+            return n;
+        }
+
+    private:
+        std::vector<char> data;
+    } log_buff;
+    std::ostream mylog(&log_buff);
+
+    void flush_log()
+    {
+        static std::ofstream file(LOG_FILE_NAME);
+        log_buff.flush_to(file);
+    }
 #else
     class NullBuffer : public std::streambuf
     {
@@ -71,7 +204,106 @@ namespace RD_NAMESPACE {
         int overflow(int c) { return c; }
     } bull_buff;
     std::ostream mylog(&bull_buff);
-#endif // RD_LOG_FILE    
+
+    void flush_log() {}
+#endif // RD_LOG_FILE
+
+/********************************/
+/*     Tracer                   */
+/********************************/
+
+// Binary per-round trace for replay analysis. Define RD_TRACE_FILE to enable it
+// Convert it with tools/trace_reader.cpp, which repeats the layout below. KEEP THEM IN SYNC
+// file   : "RDTR", uint32 TRACE_VERSION, then records
+// record : uint16 TraceType, uint16 payload size, payload
+// readers skip unknown types, so new types only need a new number
+
+#define TRACE_FILE_NAME "trace_ver10.bin"
+
+#ifdef RD_TRACE_FILE
+const bool TRACE_ON = true;
+#else
+const bool TRACE_ON = false;
+#endif // RD_TRACE_FILE
+
+const uint32_t TRACE_VERSION = 1;
+
+enum TraceType
+{
+    TRACE_ROUND = 1, // starts every player_ai call
+    TRACE_UNIT,
+    TRACE_E_GROUP, // followed by memberCnt int32 ids
+    TRACE_F_GROUP, // followed by memberCnt int32 ids
+    TRACE_ACTION,
+    TRACE_TIME
+};
+
+// the branch FGroup::action took
+enum TraceBranch
+{
+    BRANCH_NONE,
+    BRANCH_GOBACK,
+    BRANCH_ATTACK_BASE,
+    BRANCH_PROTECT_BASE,
+    BRANCH_SCOUT,
+    BRANCH_MINE,
+    BRANCH_SUPPORT,
+    BRANCH_ATTACK,
+    BRANCH_SEARCH,
+    BRANCH_FALLBACK, // repeated last orders, out of time
+    BRANCH_PLANNED // attack assigned by Conductor::plan_groups. last, so older traces keep their numbers
+};
+
+#pragma pack(push, 1)
+struct TraceRound { int32_t round, camp, gold; };
+struct TraceUnit { int32_t id, camp, kind, level, hp, mp, x, y; };
+struct TraceEGroup { int32_t groupId, kindMask, memberCnt; float danger, value, mine; };
+struct TraceFGroup { int32_t groupId, kindMask, memberCnt; float ability, health, surround; };
+struct TraceAction { int32_t groupId, branch, x, y; }; // x, y = group center
+struct TraceTime { float seconds; };
+#pragma pack(pop)
+
+// Records are collected in memory and appended to the file once per round by flush()
+class Tracer
+{
+    std::vector<char> data;
+
+    void raw(const void *p, size_t size)
+    {
+        const char *c = (const char*) p;
+        data.insert(data.end(), c, c + size);
+    }
+
+public:
+    template <class T>
+    void put(TraceType type, const T &payload, const std::vector<int32_t> &ids = std::vector<int32_t>())
+    {
+        static_assert(std::is_pod<T>::value, "trace payload must be POD");
+        if (! TRACE_ON) return;
+        size_t size = sizeof(T) + ids.size() * sizeof(int32_t);
+        assert(size < 0x10000);
+        uint16_t head[2] = { (uint16_t) type, (uint16_t) size };
+        raw(head, sizeof head);
+        raw(&payload, sizeof(T));
+        if (! ids.empty()) raw(ids.data(), ids.size() * sizeof(int32_t));
+    }
+
+    void flush()
+    {
+        if (! TRACE_ON || data.empty()) return;
+        static std::ofstream file(TRACE_FILE_NAME, std::ios::binary);
+        static bool headerDone(false);
+        if (! headerDone)
+        {
+            file.write("RDTR", 4);
+            file.write((const char*) &TRACE_VERSION, sizeof TRACE_VERSION);
+            headerDone = true;
+        }
+        file.write(data.data(), data.size());
+        file.flush();
+        data.clear();
+    }
+} tracer;
 
 /********************************/
 /*     Math Helper              */
@@ -90,6 +322,53 @@ inline T sqr(T x)
     return x*x;
 }
 
+// Hungarian method: assigns every row a distinct column at the least total cost, with rows <= columns.
+// returns the column of each row. O(rows^2 * columns)
+std::vector<int> min_cost_assignment(const std::vector<std::vector<double> > &cost)
+{
+    const int n(cost.size()), m(n ? cost[0].size() : 0);
+    std::vector<double> u(n + 1), v(m + 1), minv(m + 1);
+    std::vector<int> p(m + 1), way(m + 1); // p[j] : row at column j, 1-based. column 0 is the row being added
+    std::vector<bool> used(m + 1);
+    for (int i=1; i<=n; i++)
+    {
+        p[0] = i;
+        int j0(0);
+        std::fill(minv.begin(), minv.end(), INFINITY);
+        std::fill(used.begin(), used.end(), false);
+        do
+        {
+            used[j0] = true;
+            const int i0(p[j0]);
+            double delta(INFINITY);
+            int j1(0);
+            for (int j=1; j<=m; j++)
+                if (! used[j])
+                {
+                    const double cur(cost[i0-1][j-1] - u[i0] - v[j]);
+                    if (cur < minv[j]) minv[j] = cur, way[j] = j0;
+                    if (minv[j] < delta) delta = minv[j], j1 = j;
+                }
+            for (int j=0; j<=m; j++)
+                if (used[j])
+                    u[p[j]] += delta, v[j] -= delta;
+                else
+                    minv[j] -= delta;
+            j0 = j1;
+        } while (p[j0]);
+        do
+        {
+            const int j1(way[j0]);
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+    std::vector<int> ret(n, -1);
+    for (int j=1; j<=m; j++)
+        if (p[j]) ret[p[j]-1] = j-1;
+    return ret;
+}
+
 inline Pos &operator+=(Pos &A, const Pos &B)
 {
     A.x += B.x, A.y += B.y;
@@ -118,8 +397,6 @@ inline Pos operator*(double k, Pos A)
     return Pos(A.x*k, A.y*k);
 }
 
-struct PosCmp { bool operator()(const Pos &a, const Pos &b) const { return a.x < b.x || a.x == b.x && a.y < b.y; } };
-
 /********************************/
 /*     Global Variables         */
 /********************************/
@@ -159,6 +436,9 @@ const double NEW_MINE_MEMBER_THRESHOLD = 3;
 const double CUR_MINE_MEMBER_THRESHOLD = 2;
 const double MINE_THRESHOLD = 0.2; // remember we have this
 const double MINE_DIS_FACTOR = 0.1;
+const double FOCUS_DEF_RATE = 0.5; // ASSUMPTION: a hit takes max(1, atk - def * FOCUS_DEF_RATE) hp, see FGroup::plan_focus
+const int FOCUS_ROUND = 3; // a kill is planned if the hitters can make it in these rounds
+const double MINE_KEEP_BONUS = 0.5; // added to the score of the mine a group already goes for, see FGroup::mine_score
 const int ENEMY_MINE_ENERGY_THRESHOLD = 25;
 
 const int JOIN_DIS2_THRESHOLD = 225;
@@ -168,6 +448,7 @@ const double GOBACK_HEALTH_THRESHOLD = 0.2;
 
 const double GOBACK_SURROUND_THRESHOLD = 0.2;
 const double SUPPORT_SURROUND_THRESHOLD = 1.2;
+const double SURROUND_FACTOR_CAP = 100.0; // surround_factor of a group with no enemy around
 
 const int SEARCH_RANGE2 = 1225;
 const int ALARM_RANGE2 = 2209;
@@ -175,14 +456,506 @@ const int ALARM_RANGE2 = 2209;
 const int ALARM_ROUND = 5;
 
 const int POS_MEM_ROUND = 30;
+const double TRACK_VELOCITY_RATE = 0.5; // weight of the newest step in the smoothed velocity of an enemy
+const int TRACK_GUESS_ROUND = 3; // an enemy out of sight is guessed to keep moving for at most these rounds
+const double PREDICT_VELOCITY_RATE = 0.3; // weight of the tracked velocity in the predicted chase of an enemy, see Conductor::predict_enemies
+
+const double MINE_DRAIN = 1.0; // energy a mine is assumed to lose per round until it is seen twice
+const double MINE_DRAIN_RATE = 0.3; // weight of the newest observation in MineState::drain
+
+const int COMBAT_MAX_UNIT = 32; // units of a CombatState. more are left out
+const int COMBAT_ROUND = 5; // rounds a fight is rolled forward
+const double COMBAT_WINORDIE_RATE = 2.0; // ASSUMPTION: winordie multiplies the damage its holder deals and takes
+const int COMBAT_SACRIFICE_ROUND = 5; // ASSUMPTION: rounds of winordie given by sacrifice
+const double COMBAT_STAY_MARGIN = 0.1; // a weak group stays when fighting or holding beats retreating by this, see FGroup::checkGoback
+
+const double PLAN_BUDGET = 0.02; // seconds into a round Conductor::plan_groups may search for
+const int PLAN_BEAM = 8; // partial plans kept per group
+const int PLAN_RANGE2 = 400; // enemy groups within this of the center of a group are attack options for it
+const double PLAN_ATTACK_MARGIN = 0.2; // rollout score a joint attack must reach to beat the cascade
+
+const int INFLUENCE_CELL = 4; // side of a cell of InfluenceMap
+const int INFLUENCE_FALLOFF = 8; // cells beyond its view (its range for the threat) over which the pressure of a unit fades out
+const int INFLUENCE_REBUILD_ROUND = 16; // InfluenceMap is redrawn from scratch this often, so the kept stamps do not drift
+const double INFLUENCE_KEEP_RATE = 0.1; // a stamp is kept while its unit stays in its cell and its weight within this share
+
+const double ROUND_BUDGET = 0.06; // seconds into a round after which groups fall back to cheap actions. the judge allows 0.1
+const int DIRECT_PATH_STEPS = 16; // length of the paths of findDirectPath, beyond any unit's move in a round
+
+const int SAFE_PATH_RANGE2 = 225;
+const double SAFE_PATH_COST = 6.0; // extra cost per step at a remembered enemy, fading out to SAFE_PATH_RANGE2. scaled by EnemyTrack::confidence
+const double SAFE_PATH_IN_RANGE_COST = 6.0; // extra cost inside its attack range
+const double SAFE_PATH_BLOCK_COST = 3.0; // without RD_SAFE_ASTAR, cells of this threat cost or more are blocks of findSafePath
+const int SAFE_PATH_NEAR_DIS2 = 400; // without RD_SAFE_ASTAR, findSafePath goes the shortest way this near dest
 
 static Console *console = 0;
 
+/********************************/
+/*     Profiler                 */
+/********************************/
+
+// Define RD_PROFILE to time the scopes marked by RD_PROFILE_SCOPE. Samples of the whole match are counted
+// by scope and camp in histograms of fixed size, and PROFILE_FILE_NAME is rewritten with their percentiles every
+// PROFILE_DUMP_ROUND rounds and at the last round, since the process may be killed before any destructor runs
+
+#define PROFILE_FILE_NAME "profile_ver10.txt"
+const int PROFILE_DUMP_ROUND = 50;
+const double PROFILE_MIN_US = 0.1; // upper bound of the first bucket
+const int PROFILE_BUCKET_PER_2X = 8; // buckets per doubling, so percentiles are within 9%
+const int PROFILE_BUCKET_NUM = 27 * PROFILE_BUCKET_PER_2X; // up to ~13s
+
+struct ProfileStat
+{
+    static ProfileStat *head; // all stats, as a linked list
+
+    const char *name;
+    uint32_t bucket[2][PROFILE_BUCKET_NUM]; // by camp, see bucket_of
+    uint32_t count[2];
+    double sum[2], max[2]; // microseconds
+    ProfileStat *next;
+
+    ProfileStat(const char *_name) : name(_name), bucket(), count(), sum(), max(), next(head) { head = this; }
+
+    static int bucket_of(double us) { return us <= PROFILE_MIN_US ? 0 : std::min(PROFILE_BUCKET_NUM - 1, (int)ceil(log2(us / PROFILE_MIN_US) * PROFILE_BUCKET_PER_2X)); }
+    static double bucket_top(int i) { return PROFILE_MIN_US * exp2((double)i / PROFILE_BUCKET_PER_2X); }
+
+    void add(int camp, double us)
+    {
+        bucket[camp][bucket_of(us)]++, count[camp]++;
+        sum[camp] += us, max[camp] = std::max(max[camp], us);
+    }
+    double percentile(int camp, double q) const // the top of the bucket it falls in, at most max
+    {
+        const uint32_t k((uint32_t)(q * count[camp]));
+        uint32_t acc(0);
+        for (int i=0; i<PROFILE_BUCKET_NUM; i++)
+            if ((acc += bucket[camp][i]) > k)
+                return std::min(bucket_top(i), max[camp]);
+        return max[camp];
+    }
+};
+
+ProfileStat *ProfileStat::head = 0;
+
+class ProfileScope
+{
+    ProfileStat &stat;
+    int camp;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ProfileScope(ProfileStat &_stat) : stat(_stat), camp(console->camp()), start(std::chrono::steady_clock::now()) {}
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    ~ProfileScope()
+    {
+        stat.add(camp, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+#define RD_PROFILE_CAT_(a, b) a##b
+#define RD_PROFILE_CAT(a, b) RD_PROFILE_CAT_(a, b)
+#ifdef RD_PROFILE
+const bool PROFILE_ON = true;
+#define RD_PROFILE_SCOPE(name) static ProfileStat RD_PROFILE_CAT(profileStat, __LINE__)(name); ProfileScope RD_PROFILE_CAT(profileScope, __LINE__)(RD_PROFILE_CAT(profileStat, __LINE__))
+#else
+const bool PROFILE_ON = false;
+#define RD_PROFILE_SCOPE(name)
+#endif // RD_PROFILE
+
+void profile_dump()
+{
+    if (! PROFILE_ON) return;
+    std::ofstream os(PROFILE_FILE_NAME);
+    os << "scope camp count mean p50 p95 p99 max (us)\n";
+    for (ProfileStat *s = ProfileStat::head; s; s = s->next)
+        for (int camp=0; camp<2; camp++)
+        {
+            if (! s->count[camp]) continue;
+            os << s->name << ' ' << camp << ' ' << s->count[camp] << ' ' << s->sum[camp] / s->count[camp] << ' '
+               << s->percentile(camp, 0.5) << ' ' << s->percentile(camp, 0.95) << ' ' << s->percentile(camp, 0.99) << ' ' << s->max[camp] << '\n';
+        }
+}
+
 /********************************/
 /*     Pathfinder               */
 /********************************/
 
+// The movement rules of the judge are not known here, so by default findSafePath is the SDK's findShortestPath
+// with the threatened cells as extra blocks. define RD_SAFE_ASTAR to have it search on its own instead : an A* where
+// threat is a step cost, which findDirectPath also needs. its rules are a guess
+
+#ifdef RD_SAFE_ASTAR
+const bool SAFE_ASTAR_ON = true;
+#else
+const bool SAFE_ASTAR_ON = false;
+#endif // RD_SAFE_ASTAR
+
 void findSafePath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path);
+// the search of findSafePath alone, with RD_SAFE_ASTAR. returns false where findShortestPath should be used
+bool safe_path_search(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path);
+// no search, for the moves handed to console when the round is out of time, with RD_SAFE_ASTAR
+void findDirectPath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path);
+
+/********************************/
+/*     Order Buffer             */
+/********************************/
+
+// Moves and attacks of friendly units are collected through Conductor::work and handed to console by
+// Conductor::apply_orders in the order they were made, where the path searches of the moves are timed as well.
+// The decisions of the groups share the memo tables, the mining registry, the log and the tracer, so they
+// run on one thread
+
+#ifdef RD_THREADS
+#error "RD_THREADS is not supported : the group decisions are not thread safe, see Order Buffer"
+#endif // RD_THREADS
+
+struct Order
+{
+    const PUnit *unit;
+    const PUnit *target; // 0 for a move
+    Pos pos;
+    bool safe; // move by findSafePath
+
+    Order(const PUnit *_unit, const PUnit *_target, const Pos &_pos, bool _safe)
+        : unit(_unit), target(_target), pos(_pos), safe(_safe) {}
+};
+
+static const Order *curOrder = 0; // the one console->move is running in apply_orders
+
+// no search, for the moves handed to console when the round is out of time: the path of the unit's last move
+// towards the same dest, from where the unit is on it now. the unit stays where it is without one
+void findKeptPath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path);
+
+typedef void (*PathSearch)(const PMap &, Pos, Pos, const std::vector<Pos> &, std::vector<Pos> &);
+static PathSearch curSearch = findShortestPath; // the one findOrderPath runs
+
+// path function of every move in apply_orders: curSearch, keeping the path for findKeptPath
+void findOrderPath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path);
+
+/********************************/
+/*     Spatial Index            */
+/********************************/
+
+enum UnitKind
+{
+    KIND_OTHER,
+    KIND_HAMMERGUARD,
+    KIND_MASTER,
+    KIND_BERSERKER,
+    KIND_SCOUTER,
+    KIND_OBSERVER,
+    KIND_MINE,
+    KIND_MILITARYBASE,
+    KIND_ROSHAN,
+    KIND_DRAGON,
+    KIND_NUM
+};
+
+inline unsigned kind_bit(UnitKind k) { return 1u << k; }
+
+const unsigned ALL_KINDS = (1u << KIND_NUM) - 1;
+const unsigned MONSTER_KINDS = (1u << KIND_ROSHAN) | (1u << KIND_DRAGON);
+const unsigned HERO_KINDS = (1u << KIND_HAMMERGUARD) | (1u << KIND_MASTER) | (1u << KIND_BERSERKER) | (1u << KIND_SCOUTER);
+
+UnitKind unit_kind(const PUnit *u);
+
+enum { CAMP_FRIENDLY = 1, CAMP_ENEMY = 2, CAMP_ANY = 3 };
+
+// typed replacement of UnitFilter
+// conditions are and-ed. by default it matches anything
+class UnitQuery
+{
+    friend class UnitIndex;
+
+    int campMask;
+    unsigned kindMask;
+    bool needAlive, needNotReviving;
+
+public:
+    UnitQuery() : campMask(CAMP_ANY), kindMask(ALL_KINDS), needAlive(false), needNotReviving(false) {}
+
+    UnitQuery &friendly() { campMask = CAMP_FRIENDLY; return *this; }
+    UnitQuery &enemy() { campMask = CAMP_ENEMY; return *this; }
+    UnitQuery &kinds(unsigned mask) { kindMask &= mask; return *this; }
+    UnitQuery &type(UnitKind k) { return kinds(kind_bit(k)); }
+    UnitQuery &avoid(UnitKind k) { kindMask &= ~kind_bit(k); return *this; }
+    UnitQuery &alive() { needAlive = true; return *this; } // = setHpFilter(1, 0x7fffffff)
+    UnitQuery &not_reviving() { needNotReviving = true; return *this; }
+};
+
+class UnitTable;
+
+// uniform grid over info->units, built once per round in Conductor::init
+class UnitIndex
+{
+public:
+    struct Entry
+    {
+        const PUnit *unit;
+        Pos pos;
+        int camp; // CAMP_FRIENDLY or CAMP_ENEMY
+        UnitKind kind;
+        bool alive, reviving;
+    };
+
+private:
+    static const int CELL_SIZE = 8;
+    static const int GRID_SIZE = (MAP_SIZE + CELL_SIZE - 1) / CELL_SIZE;
+
+    std::vector<Entry> entries; // same order as info->units
+    std::vector<int> cellStart, cellItem; // entries bucketed by cell, bucket c is cellItem[cellStart[c], cellStart[c+1])
+
+    static int cell_of(int x) { return x < 0 ? 0 : x >= MAP_SIZE ? GRID_SIZE - 1 : x / CELL_SIZE; }
+
+    static bool match(const Entry &e, const UnitQuery &q)
+    {
+        return (e.camp & q.campMask) && (kind_bit(e.kind) & q.kindMask) &&
+               (! q.needAlive || e.alive) && (! q.needNotReviving || ! e.reviving);
+    }
+
+    // f returns true to stop. returns whether stopped
+    template <class F>
+    bool scan(const Pos &c, int r2, const UnitQuery &q, F f) const
+    {
+        int r = (int)ceil(sqrt((double)r2));
+        int x0(cell_of(c.x - r)), x1(cell_of(c.x + r)), y0(cell_of(c.y - r)), y1(cell_of(c.y + r));
+        for (int x=x0; x<=x1; x++)
+            for (int y=y0; y<=y1; y++)
+            {
+                int cell = x * GRID_SIZE + y;
+                for (int i=cellStart[cell]; i<cellStart[cell+1]; i++)
+                {
+                    const Entry &e = entries[cellItem[i]];
+                    if (dis2(e.pos, c) <= r2 && match(e, q) && f(e))
+                        return true;
+                }
+            }
+        return false;
+    }
+
+public:
+    void build(const PPlayerInfo &info, const UnitTable &table); // table holds info->units as its first rows
+
+    const std::vector<Entry> &get_entries() const { return entries; }
+
+    template <class F>
+    void for_each(const UnitQuery &q, F f) const
+    {
+        for (const Entry &e : entries)
+            if (match(e, q)) f(e.unit);
+    }
+
+    template <class F>
+    void for_each(const Pos &c, int r2, const UnitQuery &q, F f) const
+    {
+        scan(c, r2, q, [&](const Entry &e) { f(e.unit); return false; });
+    }
+
+    bool any(const Pos &c, int r2, const UnitQuery &q) const
+    {
+        return scan(c, r2, q, [](const Entry &) { return true; });
+    }
+
+    int count(const Pos &c, int r2, const UnitQuery &q) const
+    {
+        int ret(0);
+        scan(c, r2, q, [&](const Entry &) { ret++; return false; });
+        return ret;
+    }
+
+    // the one appearing first in info->units, as UnitFilter results do
+    const PUnit *first(const Pos &c, int r2, const UnitQuery &q) const
+    {
+        const Entry *ret(0);
+        scan(c, r2, q, [&](const Entry &e) { if (! ret || &e < ret) ret = &e; return false; });
+        return ret ? ret->unit : 0;
+    }
+};
+
+/********************************/
+/*     Unit Table               */
+/********************************/
+
+// Attributes of units as columns, read through console (the string-keyed unitArg and getBuff) once per unit
+// in a round. Conductor::init adds every unit in info and computes the factors below in one pass over the
+// columns. units not in info (saved snapshots) are added when first asked for.
+// buffs are read through Conductor::has_buff and Conductor::buff_left rather than by name
+
+enum BuffType
+{
+    BUFF_WINORDIE,
+    BUFF_DIZZY,
+    BUFF_WAITREVIVE,
+    BUFF_ISMINING,
+    BUFF_REVIVING,
+    BUFF_BEATTACKED,
+    BUFF_NUM
+};
+
+const char *const BUFF_NAME[BUFF_NUM] = { "winordie", "dizzy", "waitrevive", "ismining", "reviving", "beattacked" };
+
+inline unsigned buff_bit(BuffType b) { return 1u << b; }
+
+class UnitTable
+{
+    std::vector<int> rowOf; // unit id -> row, -1 if not added this round
+
+public:
+    std::vector<int> id;
+    std::vector<UnitKind> kind;
+    std::vector<unsigned char> hero, moves; // isHero(), and neither base nor mine
+    std::vector<unsigned> buffs; // buff_bit of the buffs on
+    std::vector<int> buffLeft; // timeLeft at row * BUFF_NUM + buff, -1 if off
+    std::vector<double> hp, maxHp, hpRegen, mp, maxMp, mpRegen, atk, def, speed;
+
+    // Unit::strength_factor, and the parts of EUnit::value_factor not depending on other units
+    std::vector<double> strength, valueDanger, valueDiv;
+
+    void clear();
+    int add(const PUnit *u); // returns the row
+    void compute(int from, int to); // factors of rows [from, to)
+
+    int size() const { return id.size(); }
+    int row(int _id) const { return _id >= 0 && _id < (int)rowOf.size() ? rowOf[_id] : -1; }
+
+    bool has_buff(int r, BuffType b) const { return buffs[r] & buff_bit(b); }
+    int buff_left(int r, BuffType b) const { return buffLeft[r * BUFF_NUM + b]; }
+};
+
+/********************************/
+/*     Combat Rollout           */
+/********************************/
+
+// A local fight rolled forward from a snapshot (FGroup::combat_snapshot) on flat copies of the units, to weigh
+// fighting against holding or retreating. each round every unit picks the nearest living opponent, then hits it
+// if in range and ready, or else moves towards it, all at once. units with step 0 (bases, monsters) stay.
+// the state is copied on the stack and nothing is allocated, so a round affords dozens of rollouts
+
+enum CombatPolicy { COMBAT_FIGHT, COMBAT_HOLD, COMBAT_RETREAT }; // of the friends. enemies always fight
+
+struct CombatUnit
+{
+    int id;
+    bool enemy;
+    float x, y, hp, atk, def;
+    float step, range2; // cells moved per round, squared attack range
+    float weight; // strength_factor, the share of the unit in the loss of its side
+    int cd, maxCd, dizzy, winordie; // rounds left
+};
+
+struct CombatState
+{
+    int n;
+    float homeX, homeY; // where the friends retreat to
+    CombatUnit unit[COMBAT_MAX_UNIT];
+
+    CombatUnit *add() { return n < COMBAT_MAX_UNIT ? unit + n++ : 0; } // 0 if full
+    int find(int id) const
+    {
+        for (int i=0; i<n; i++)
+            if (unit[i].id == id)
+                return i;
+        return -1;
+    }
+};
+
+static_assert(std::is_pod<CombatState>::value, "CombatState is copied as plain memory");
+
+// adds p as of this round unless it is dead, reviving or s is full. false if not added
+bool combat_add(CombatState &s, const PUnit *p, bool enemy);
+
+struct CombatOutcome
+{
+    double friendLoss, enemyLoss; // weighted share of hp lost by each side, in [0,1]
+    double score() const { return enemyLoss - friendLoss; }
+};
+
+// losses are counted from the hp in base if given, the same units as start before a change made to it
+inline CombatOutcome combat_rollout(const CombatState &start, CombatPolicy policy, int rounds = COMBAT_ROUND, const CombatState *base = 0)
+{
+    CombatState s;
+    s.n = start.n, s.homeX = start.homeX, s.homeY = start.homeY;
+    memcpy(s.unit, start.unit, sizeof(CombatUnit) * start.n);
+    int target[COMBAT_MAX_UNIT];
+    float damage[COMBAT_MAX_UNIT];
+    for (int r=0; r<rounds; r++)
+    {
+        bool alive[2] = { false, false };
+        for (int i=0; i<s.n; i++)
+        {
+            const CombatUnit &u = s.unit[i];
+            target[i] = -1, damage[i] = 0;
+            if (u.hp <= 0) continue;
+            alive[u.enemy] = true;
+            float best(INFINITY);
+            for (int j=0; j<s.n; j++)
+            {
+                const CombatUnit &v = s.unit[j];
+                if (v.enemy == u.enemy || v.hp <= 0) continue;
+                const float d2(sqr(v.x - u.x) + sqr(v.y - u.y));
+                if (d2 < best)
+                    best = d2, target[i] = j;
+            }
+        }
+        if (! alive[0] || ! alive[1]) break;
+
+        // hits and moves are decided on the positions at the start of the round, so the order of units does not matter
+        for (int i=0; i<s.n; i++)
+        {
+            CombatUnit &u = s.unit[i];
+            if (target[i] == -1 || u.dizzy > 0) continue;
+            const CombatUnit &t = s.unit[target[i]];
+            const bool retreat(! u.enemy && policy == COMBAT_RETREAT), hold(! u.enemy && policy == COMBAT_HOLD);
+            if (! retreat && sqr(t.x - u.x) + sqr(t.y - u.y) <= u.range2)
+            {
+                if (u.cd > 0) continue;
+                double hit = (u.atk - t.def * FOCUS_DEF_RATE) * (u.winordie > 0 ? COMBAT_WINORDIE_RATE : 1) * (t.winordie > 0 ? COMBAT_WINORDIE_RATE : 1);
+                damage[target[i]] += std::max(1.0, hit);
+                u.cd = u.maxCd;
+            } else if (! hold)
+            {
+                const float gx(retreat ? s.homeX : t.x), gy(retreat ? s.homeY : t.y), d(std::sqrt(sqr(gx - u.x) + sqr(gy - u.y)));
+                const float step(std::min(u.step, retreat ? d : d - std::sqrt(u.range2)));
+                if (d > 0 && step > 0)
+                    u.x += (gx - u.x) * step / d, u.y += (gy - u.y) * step / d;
+            }
+        }
+        for (int i=0; i<s.n; i++)
+        {
+            CombatUnit &u = s.unit[i];
+            u.hp -= damage[i];
+            if (u.cd > 0) u.cd--;
+            if (u.dizzy > 0) u.dizzy--;
+            if (u.winordie > 0) u.winordie--;
+        }
+    }
+
+    double lost[2] = { 0, 0 }, total[2] = { 0, 0 };
+    for (int i=0; i<s.n; i++)
+    {
+        const CombatUnit &u = (base ? *base : start).unit[i];
+        if (u.hp <= 0) continue;
+        total[u.enemy] += u.weight;
+        lost[u.enemy] += u.weight * (u.hp - std::max(0.0f, s.unit[i].hp)) / u.hp;
+    }
+    CombatOutcome ret;
+    ret.friendLoss = total[0] > 0 ? lost[0] / total[0] : 0;
+    ret.enemyLoss = total[1] > 0 ? lost[1] / total[1] : 0;
+    return ret;
+}
+
+// Define RD_PLANNER to have Conductor::plan_groups search joint attacks of the groups on enemy groups with heroes,
+// by rollouts, before the groups act. a group planned to attack does so right after its urgent checks
+// (goback, attack base, protect base). the search stops at PLAN_BUDGET with the best plan so far, the groups left
+// over and those without a plan run the cascade of FGroup::decide as without the flag
+
+#ifdef RD_PLANNER
+const bool PLAN_ON = true;
+#else
+const bool PLAN_ON = false;
+#endif // RD_PLANNER
 
 /********************************/
 /*     Characters               */
@@ -257,11 +1030,14 @@ class Unit
 
 protected:
     int id;
-    Character *character;
+    UnitKind kind;
+    Character *character; // into characterCell
+    typename std::aligned_storage<sizeof(Character), alignof(Character)>::type characterCell;
     CampGroup *belongs;
     
 public:
     int get_id() const { return id; }
+    UnitKind get_kind() const { return kind; }
 
     PUnit *get_entity();
     const PUnit *get_entity() const;
@@ -273,7 +1049,7 @@ public:
     Unit<CampGroup, CampUnit> &operator=(const Unit<CampGroup, CampUnit> &) = delete;
     Unit(Unit<CampGroup, CampUnit> &&) = delete;
     Unit<CampGroup, CampUnit> &operator=(Unit<CampGroup, CampUnit> &&) = delete;
-    ~Unit() { delete character; } // will not be called until end
+    ~Unit() { character->~Character(); } // run by UnitSlab when its Conductor goes
     
     double strength_factor() const;
 };
@@ -286,6 +1062,11 @@ class Group
 protected:
     std::vector<CampUnit*> member;
     std::set<int> idSet;
+    unsigned kindMask; // kind_bit of all members
+    mutable int memoKey;
+    mutable unsigned memoKeyEpoch;
+
+    void update_kind_mask();
 
 public:
     int groupId;
@@ -297,42 +1078,56 @@ public:
     const std::vector<CampUnit*> &get_member() const { return member; }
 
     void add_member(CampUnit *unit);
+    void clear_member();
 
-    Group() : groupId(++groupIdCnt) {}
+    Group() : kindMask(0), memoKeyEpoch(0), groupId(++groupIdCnt) {}
     Group(const Group<CampGroup, CampUnit> &other) = delete;
     Group<CampGroup, CampUnit> &operator=(const Group<CampGroup, CampUnit> &other) = delete;
 
     Group(Group<CampGroup, CampUnit> &&other)
-        : member(std::move(other.member)), idSet(std::move(other.idSet)), groupId(other.groupId)
+        : member(std::move(other.member)), idSet(std::move(other.idSet)), kindMask(other.kindMask),
+          memoKey(other.memoKey), memoKeyEpoch(other.memoKeyEpoch), groupId(other.groupId)
     {
         for (CampUnit *u : member)
             u->belongs = (CampGroup*) this;
         other.member.clear();
+        other.kindMask = 0, other.memoKeyEpoch = 0;
     }
 
     Group<CampGroup, CampUnit> &operator=(Group<CampGroup, CampUnit> &&other)
     {
-        member = std::move(other.member), idSet = std::move(other.idSet), groupId = other.groupId;
+        member = std::move(other.member), idSet = std::move(other.idSet), kindMask = other.kindMask, groupId = other.groupId;
+        memoKey = other.memoKey, memoKeyEpoch = other.memoKeyEpoch;
         for (CampUnit *u : member)
             u->belongs = (CampGroup*) this;
         other.member.clear();
+        other.kindMask = 0, other.memoKeyEpoch = 0;
         return *this;
     }
 
+    // dense key for Memo, assigned at the first use in a round
+    int memo_key() const
+    {
+        if (memoKeyEpoch != memoEpoch)
+            memoKey = memoGroupKeyCnt++, memoKeyEpoch = memoEpoch;
+        return memoKey;
+    }
+
     Pos center() const // don't cache this because join/split
     {
         int num(0);
         Pos ret(0, 0);
         for (const CampUnit *u : member)
         {
-            int weight(lowerCase(u->get_entity()->name) == "master" ? 3 : 1);
+            int weight(u->get_kind() == KIND_MASTER ? 3 : 1);
             ret += u->get_entity()->pos * weight;
             num += weight;
         }
         return ret * (1.0 / num);
     }
 
-    bool has_type(const std::string &s) const;
+    bool has_type(UnitKind k) const { return kindMask & kind_bit(k); }
+    unsigned kind_mask() const { return kindMask; }
     
     void logMsg() const;
 };
@@ -355,12 +1150,7 @@ public:
     bool ready_for(const FUnit *u, const char *skill, int range) const;
     Pos predict_pos() const;
     
-    double danger_factor() const
-    {
-        double ret = strength_factor() * DANGER_FACTOR;
-        if (get_entity()->findBuff("winordie")) ret *= WINORDIE_DANGER_RATE;
-        return ret;
-    }
+    double danger_factor() const;
     double value_factor() const;
 };
 
@@ -369,6 +1159,8 @@ class FUnit : public Unit<FGroup, FUnit> // Friend Unit
     friend FGroup;
     
     int madeAction; // = round
+    int lastTarget; // target id of the last attack order, -1 if the last order was a move
+    Pos lastPos; // destination of the last move order
 
     bool escape_sacrifice();
     void attack(const EGroup &target);
@@ -383,6 +1175,11 @@ public:
     FUnit &operator=(FUnit &&) = delete;
     
     int cover_by_ready_num() const;
+
+    // moves and attacks go through conductor.put_order, and are remembered for repeat_order
+    void order_move(const Pos &p);
+    void order_attack(const PUnit *target);
+    void repeat_order(); // cheap fallback when out of time
     
     double ability_factor() const { return strength_factor() * ABILITY_FACTOR; }
     double health_factor() const;
@@ -392,15 +1189,17 @@ public:
 
 class EGroup : public Group<EGroup, EUnit> // Enemy Group
 {
+    int foundRound; // groups persist across rounds while their members stay together
+
 public:
-    void add_adj_members_recur(EUnit *unit);
+    EGroup() : foundRound(console->round()) {}
 
     //functions below return in [0,1]
     double danger_factor() const;
     double value_factor() const;
     double mine_factor() const;
     
-    bool has_player() const { return has_type("hammerguard") || has_type("master") || has_type("berserker") || has_type("scouter"); }
+    bool has_player() const { return kindMask & HERO_KINDS; }
     
     void logMsg() const;
 };
@@ -409,54 +1208,291 @@ class FGroup : public Group<FGroup, FUnit> // Friend Group
 {
     int foundRound;
     Pos curMinePos, curScoutPos;
+    Pos nextMinePos; // given by Conductor::assign_mines this round
     bool attackBase;
 
+    // targets of the members against focusGroup, planned at the first attack of a round
+    mutable std::vector<std::pair<int, const EUnit*> > focus;
+    mutable int focusGroup;
+    mutable unsigned focusEpoch;
+
+    const EGroup *plannedTarget; // by Conductor::plan_groups, valid in round plannedEpoch
+    unsigned plannedEpoch;
+
+    void plan_focus(const EGroup &target) const;
+
     void releaseMine();
     void releaseScout() { curScoutPos = Pos(-1, -1); }
 
-    bool checkGoback();
-    bool checkAttackBase();
-    bool checkProtectBase();
-    bool checkScout();
-    bool checkAttack();
-    bool checkMine();
-    bool checkSupport();
-    bool checkSearch();
+    bool checkGoback();
+    bool checkAttackBase();
+    bool checkProtectBase();
+    bool checkPlanned();
+    bool checkScout();
+    bool checkAttack();
+    bool checkMine();
+    bool checkSupport();
+    bool checkSearch();
+
+    TraceBranch decide(); // runs the checks above in priority order
+
+public:
+    FGroup()
+        : Group<FGroup, FUnit>(), foundRound(console->round()), curMinePos(-1, -1), curScoutPos(-1, -1), nextMinePos(-1, -1), attackBase(false), focusGroup(-1), focusEpoch(0), plannedTarget(0), plannedEpoch(0) {}
+    
+    FGroup(FGroup &&other)
+        : Group<FGroup, FUnit>((Group<FGroup,FUnit>&&)other),
+          foundRound(other.foundRound), curMinePos(other.curMinePos), curScoutPos(other.curScoutPos), nextMinePos(other.nextMinePos), attackBase(other.attackBase), focusGroup(-1), focusEpoch(0), plannedTarget(0), plannedEpoch(0)
+    { other.curMinePos = other.curScoutPos = other.nextMinePos = Pos(-1, -1), other.attackBase = false; }
+    
+    FGroup &operator=(FGroup &&other)
+    {
+        Group<FGroup, FUnit>::operator=((Group<FGroup,FUnit>&&)other);
+        foundRound = other.foundRound;
+        curMinePos = other.curMinePos;
+        curScoutPos = other.curScoutPos;
+        nextMinePos = other.nextMinePos;
+        attackBase = other.attackBase;
+        focusEpoch = 0;
+        plannedEpoch = 0;
+        other.curMinePos = Pos(-1, -1);
+        other.curScoutPos = Pos(-1, -1);
+        other.nextMinePos = Pos(-1, -1);
+        other.attackBase = false;
+        return *this;
+    }
+
+    ~FGroup() { releaseMine(), releaseScout(); }
+
+    void action();
+    void fallback(); // repeat the last orders, for when out of time
+    int priority() const; // groups of higher priority act first
+    
+    bool checkJoin();
+    bool checkSplit();
+    
+    double ability_factor() const;
+    double health_factor() const;
+    double surround_factor() const;
+    
+    const EGroup *in_battle() const;
+
+    const Pos &get_cur_mine() const { return curMinePos; }
+    void set_next_mine(const Pos &p) { nextMinePos = p; }
+    double mine_score(int mine) const; // how much the group wants to go for the mine, <= 0 if not at all
+    const EUnit *focus_target(const FUnit *u, const EGroup &target) const; // 0 if u reaches none of target
+
+    void combat_snapshot(CombatState &s) const; // the living members, and the enemy groups in their view as surround_factor counts
+    CombatOutcome combat_outcome(CombatPolicy policy) const; // combat_rollout of combat_snapshot
+
+    void set_planned_target(const EGroup *g) { plannedTarget = g, plannedEpoch = memoEpoch; }
+};
+
+/********************************/
+/*     Unit Slab                */
+/********************************/
+
+// Unit objects by id, constructed in place in chunks of SLAB_CHUNK at the first use.
+// ids are small and dense, so a lookup is two indexings. units never move, since groups point to them,
+// and are destroyed with the slab
+template <class T>
+class UnitSlab
+{
+    static const int SLAB_CHUNK = 64;
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Cell;
+
+    std::vector<std::unique_ptr<Cell[]> > chunks;
+    std::vector<bool> made; // by id
+
+    T *at(int id) const { return reinterpret_cast<T*>(&chunks[id / SLAB_CHUNK][id % SLAB_CHUNK]); }
+
+public:
+    UnitSlab() {}
+    UnitSlab(const UnitSlab<T> &) = delete;
+    UnitSlab<T> &operator=(const UnitSlab<T> &) = delete;
+
+    ~UnitSlab()
+    {
+        for (int id=0; id<(int)made.size(); id++)
+            if (made[id])
+                at(id)->~T();
+    }
+
+    T *find(int id) const { return id >= 0 && id < (int)made.size() && made[id] ? at(id) : 0; }
+
+    T *get(int id)
+    {
+        if (T *ret = find(id)) return ret;
+        while ((int)chunks.size() * SLAB_CHUNK <= id)
+            chunks.push_back(std::unique_ptr<Cell[]>(new Cell[SLAB_CHUNK]));
+        T *ret = new (at(id)) T(id);
+        if (id >= (int)made.size())
+            made.resize(id + 1, false);
+        made[id] = true;
+        return ret;
+    }
+};
+
+/********************************/
+/*     Enemy Track              */
+/********************************/
+
+// What is known of an enemy unit, kept across rounds by Conductor::update_enemy_pos.
+// the ones seen within POS_MEM_ROUND are listed once per round, see Conductor::get_enemy_tracks
+struct EnemyTrack
+{
+    int id;
+    Pos pos; // when last seen
+    int round; // last seen, -1 if never
+    double vx, vy; // cells per round, smoothed over the rounds seen in a row
+    double confidence; // 1 when seen this round, falling linearly to 0 after POS_MEM_ROUND
+
+    EnemyTrack() : id(-1), pos(-1, -1), round(-1), vx(0), vy(0), confidence(0) {}
+
+    Pos guess(int now) const // where it is likely to be by now
+    {
+        const int t(std::min(now - round, TRACK_GUESS_ROUND));
+        return Pos(std::max(0, std::min(MAP_SIZE - 1, (int)lround(pos.x + vx * t))),
+                   std::max(0, std::min(MAP_SIZE - 1, (int)lround(pos.y + vy * t))));
+    }
+};
+
+/********************************/
+/*     Mine Table               */
+/********************************/
+
+// State of every mine, by its index in MINE_POS (the mine id). kept by Conductor::update_energy
+struct MineState
+{
+    Pos pos;
+    double energy; // exact when seen this round, otherwise forecast by drain
+    double drain; // energy lost per round, smoothed over sightings. negative when it regenerates
+    int seenRound; // -1 if never
+    int claimedBy; // id of the FGroup mining it, -1 if none
+    const EGroup *visible; // the enemy group of the mine unit this round, 0 if out of sight
+
+    MineState() : pos(-1, -1), energy(0), drain(MINE_DRAIN), seenRound(-1), claimedBy(-1), visible(0) {}
+
+    double energy_after(int rounds) const { return std::max(0.0, energy - drain * rounds); }
+};
+
+// -1 if p is not the position of a mine
+inline int mine_id(const Pos &p)
+{
+    static std::vector<signed char> id;
+    if (id.empty())
+    {
+        id.assign(MAP_SIZE * MAP_SIZE, -1);
+        for (int i=0; i<MINE_NUM; i++)
+            id[MINE_POS[i].x * MAP_SIZE + MINE_POS[i].y] = i;
+    }
+    return p.x >= 0 && p.y >= 0 && p.x < MAP_SIZE && p.y < MAP_SIZE ? id[p.x * MAP_SIZE + p.y] : -1;
+}
+
+/********************************/
+/*     Influence Map            */
+/********************************/
+
+// Pressure of each side over the map, on a grid of INFLUENCE_CELL cells. each unit puts a stamp of its weight,
+// full within a radius and fading out linearly beyond it. Conductor::update_influence puts them once per round;
+// a unit that stays in its grid cell with about the same weight keeps last round's stamp, so only the moved ones
+// are redrawn. reading a layer is then a lookup, see Conductor::pressure
+
+enum InfluenceLayer
+{
+    INFLUENCE_FRIEND, // ability_factor, over the view
+    INFLUENCE_ENEMY, // danger_factor by EnemyTrack::confidence, over the view
+    INFLUENCE_THREAT, // EnemyTrack::confidence, over the attack range, fading out to SAFE_PATH_RANGE2. for findSafePath
+    INFLUENCE_LAYER_NUM
+};
+
+class InfluenceMap
+{
+public:
+    static const int GRID_SIZE = (MAP_SIZE + INFLUENCE_CELL - 1) / INFLUENCE_CELL;
+
+private:
+    struct Stamp
+    {
+        float x, y; // in cells of the grid
+        float full, zero; // radius of the full weight, and where it is gone, in cells of the grid
+        float weight; // 0 if none
+        int round; // last put
+    };
+
+    std::vector<float> grid[INFLUENCE_LAYER_NUM];
+    std::vector<Stamp> stamps[INFLUENCE_LAYER_NUM]; // by unit id
+    int builtRound; // of the last full rebuild, -1 if never
+
+    void draw(std::vector<float> &g, const Stamp &s, float sign)
+    {
+        const int x0(std::max(0, (int)floor(s.x - s.zero))), x1(std::min(GRID_SIZE - 1, (int)ceil(s.x + s.zero))),
+                  y0(std::max(0, (int)floor(s.y - s.zero))), y1(std::min(GRID_SIZE - 1, (int)ceil(s.y + s.zero)));
+        for (int x=x0; x<=x1; x++)
+            for (int y=y0; y<=y1; y++)
+            {
+                const float d(std::sqrt(sqr(x + 0.5f - s.x) + sqr(y + 0.5f - s.y)));
+                if (d >= s.zero) continue;
+                g[x * GRID_SIZE + y] += sign * s.weight * (d <= s.full ? 1 : (s.zero - d) / (s.zero - s.full));
+            }
+    }
 
 public:
-    FGroup()
-        : Group<FGroup, FUnit>(), foundRound(console->round()), curMinePos(-1, -1), curScoutPos(-1, -1), attackBase(false) {}
-    
-    FGroup(FGroup &&other)
-        : Group<FGroup, FUnit>((Group<FGroup,FUnit>&&)other),
-          foundRound(other.foundRound), curMinePos(other.curMinePos), curScoutPos(other.curScoutPos), attackBase(other.attackBase)
-    { other.curMinePos = other.curScoutPos = Pos(-1, -1), other.attackBase = false; }
-    
-    FGroup &operator=(FGroup &&other)
+    InfluenceMap() : builtRound(-1) {}
+
+    void begin(int round) // before the puts of a round
     {
-        Group<FGroup, FUnit>::operator=((Group<FGroup,FUnit>&&)other);
-        foundRound = other.foundRound;
-        curMinePos = other.curMinePos;
-        curScoutPos = other.curScoutPos;
-        attackBase = other.attackBase;
-        other.curMinePos = Pos(-1, -1);
-        other.curScoutPos = Pos(-1, -1);
-        other.attackBase = false;
-        return *this;
+        if (~builtRound && round - builtRound < INFLUENCE_REBUILD_ROUND) return;
+        builtRound = round;
+        for (int l=0; l<INFLUENCE_LAYER_NUM; l++)
+        {
+            grid[l].assign(GRID_SIZE * GRID_SIZE, 0);
+            for (Stamp &s : stamps[l])
+                s.weight = 0;
+        }
     }
 
-    ~FGroup() { releaseMine(), releaseScout(); }
+    // full and zero are radii in cells of the map
+    void put(InfluenceLayer l, int id, int round, const Pos &p, double full, double zero, double weight)
+    {
+        if (id >= (int)stamps[l].size())
+            stamps[l].resize(id + 1, Stamp{ 0, 0, 0, 0, 0, -1 });
+        Stamp &s = stamps[l][id];
+        s.round = round;
+        const float x((p.x + 0.5f) / INFLUENCE_CELL), y((p.y + 0.5f) / INFLUENCE_CELL);
+        if (
+            s.weight != 0 && (int)s.x == (int)x && (int)s.y == (int)y &&
+            fabs(weight - s.weight) <= fabs(s.weight) * INFLUENCE_KEEP_RATE
+           ) return;
+        if (s.weight != 0) draw(grid[l], s, -1);
+        s.x = x, s.y = y, s.full = full / INFLUENCE_CELL, s.zero = std::max(zero, full + 1) / INFLUENCE_CELL, s.weight = weight;
+        if (s.weight != 0) draw(grid[l], s, 1);
+    }
 
-    void action();
-    
-    bool checkJoin();
-    bool checkSplit();
-    
-    double ability_factor() const;
-    double health_factor() const;
-    double surround_factor() const;
-    
-    const EGroup *in_battle() const;
+    void end(int round) // after the puts of a round, takes off the units not put
+    {
+        for (int l=0; l<INFLUENCE_LAYER_NUM; l++)
+            for (Stamp &s : stamps[l])
+                if (s.weight != 0 && s.round != round)
+                    draw(grid[l], s, -1), s.weight = 0;
+    }
+
+    float at(InfluenceLayer l, const Pos &p) const
+    {
+        const int x(std::min(std::max(p.x, 0), MAP_SIZE - 1) / INFLUENCE_CELL), y(std::min(std::max(p.y, 0), MAP_SIZE - 1) / INFLUENCE_CELL);
+        return std::max(grid[l][x * GRID_SIZE + y], 0.0f); // what the removed stamps leave of rounding
+    }
+
+    float interpolate(InfluenceLayer l, int px, int py) const // bilinear between the centers of the cells
+    {
+        const float fx(std::min(std::max((px + 0.5f) / INFLUENCE_CELL - 0.5f, 0.0f), GRID_SIZE - 1.0f)),
+                    fy(std::min(std::max((py + 0.5f) / INFLUENCE_CELL - 0.5f, 0.0f), GRID_SIZE - 1.0f));
+        const int x0(fx), y0(fy), x1(std::min(x0 + 1, GRID_SIZE - 1)), y1(std::min(y0 + 1, GRID_SIZE - 1));
+        const float ax(fx - x0), ay(fy - y0);
+        const std::vector<float> &g = grid[l];
+        return std::max((g[x0 * GRID_SIZE + y0] * (1 - ay) + g[x0 * GRID_SIZE + y1] * ay) * (1 - ax) +
+                        (g[x1 * GRID_SIZE + y0] * (1 - ay) + g[x1 * GRID_SIZE + y1] * ay) * ax, 0.0f);
+    }
 };
 
 /********************************/
@@ -479,30 +1515,72 @@ public:
 private:
     std::default_random_engine generator;
     
-    std::unordered_map<int, EUnit*> eUnitObj;
-    std::unordered_map<int, FUnit*> fUnitObj;
-    std::unordered_map<int, std::pair<PUnit*, bool> > pUnits; // second = true means that is a copy
+    UnitSlab<EUnit> eUnitObj;
+    UnitSlab<FUnit> fUnitObj;
+    // unit snapshots by id. units in this round point into info->units, the others to their copies saved when last seen.
+    // copies are assigned in place, so a unit costs one allocation for the whole game
+    std::vector<PUnit*> pUnits;
+    std::vector<PUnit> pUnitSaved;
+    std::vector<int> pUnitSlot; // id -> index in pUnitSaved, -1 if never saved
 
     std::vector<EGroup> eGroups;
     std::vector<FGroup> fGroups;
 
+    struct ClusterNode // an enemy unit in the last enemy_make_groups
+    {
+        int stamp; // = clusterStamp at that time
+        Pos pos;
+        bool alive;
+        std::vector<int> adj; // ids of the units linked to
+        ClusterNode() : stamp(-1), alive(false) {}
+    };
+    std::vector<ClusterNode> clusterNodes; // indexed by unit id
+    int clusterStamp;
+
+    UnitIndex index;
+    UnitTable table;
+
     const PMap *map;
     const PPlayerInfo *info;
     PCommand *cmd;
 
     int hammerguardCnt, masterCnt, berserkerCnt, scouterCnt;
     int alarm;
-    std::map<Pos, int, PosCmp> mining;
-    std::map<Pos, int, PosCmp> mineEnergy;
-    std::map<int, std::pair<Pos, int /*round*/> > enemyPos;
+    std::vector<MineState> mines; // by mine id
+    std::vector<EnemyTrack> enemyTrack; // by unit id
+    std::vector<EnemyTrack> enemyKnown; // the ones in memory this round, by id, with pos replaced by the guess
+    std::vector<int> knownCellStart, knownCellItem; // enemyKnown bucketed by KNOWN_CELL_SIZE cells, like UnitIndex
+    std::vector<Pos> predictPos; // by unit id, valid in round predictRound
+    std::vector<int> predictRound;
+    static const int KNOWN_CELL_SIZE = 16;
+    static const int KNOWN_GRID_SIZE = (MAP_SIZE + KNOWN_CELL_SIZE - 1) / KNOWN_CELL_SIZE;
+
+    // blocks for findShortestPath: mine cells and bases first, which never change, then units of this round
+    std::vector<Pos> blocks;
+    int staticBlockCnt;
+    std::vector<int> unitBlock; // unit id -> index in blocks, -1 if none
+
+    void make_blocks();
+
+    InfluenceMap influence;
+    std::vector<float> threatCost; // extra step cost of findSafePath, see get_threat_cost
+    std::vector<Pos> safeBlocks; // blocks, then the cells of threatCost of at least SAFE_PATH_BLOCK_COST
+    unsigned threatEpoch;
+
+    std::chrono::steady_clock::time_point roundStart;
+
+    std::vector<Order> orders; // of this round, see Order Buffer
+    bool safePath;
+    std::vector<std::pair<Pos, std::vector<Pos> > > keptPath; // by unit id: dest and path of its last move handed to console
 
     Conductor()
-        : generator(seed), map(0), info(0), cmd(0), hammerguardCnt(0), masterCnt(0), berserkerCnt(0), scouterCnt(0), alarm(-1)
+        : generator(seed), clusterStamp(0), map(0), info(0), cmd(0), hammerguardCnt(0), masterCnt(0), berserkerCnt(0), scouterCnt(0), alarm(-1), staticBlockCnt(-1), threatEpoch(0), safePath(false)
     {
-        mylog << "RandomSeed : " << seed << std::endl;
+        RD_LOG(LOG_ROUND) << "RandomSeed : " << seed << '\n';
         
+        mines.resize(MINE_NUM);
         for (int i=0; i<MINE_NUM; i++)
-            mineEnergy[MINE_POS[i]] = (i ? 0 : MAX_ROUND * 2);
+            mines[i].pos = MINE_POS[i], mines[i].energy = (i ? 0 : MAX_ROUND * 2);
     }
 
     // functions below return value in [0,1]
@@ -522,42 +1600,44 @@ private:
     void check_callback_hero();
     void check_upgrade_hero();
     void check_base_attack();
+    void assign_mines();
+    void plan_groups(const std::vector<FGroup*> &order);
     
     void update_energy();
-    void set_energy(const Pos &p, int energy) { mineEnergy[p] = energy; }
     
     void update_enemy_pos();
-    void set_enemy_pos(int id, const Pos &p) { enemyPos[id] = std::make_pair(p, console->round()); }
+    void set_enemy_pos(int id, const Pos &p);
+    void predict_enemies();
+    void update_influence();
 
 public:
     const PMap &get_map() const { return *map; }
     const PPlayerInfo &get_info() const { return *info; }
     const PCommand &get_cmd() const { return *cmd; }
+    const UnitIndex &get_index() const { return index; }
+    const UnitTable &get_table() const { return table; }
+    int table_row(int id); // adds the unit to table if not yet
+    bool has_buff(const PUnit *u, BuffType b) { return table.has_buff(table_row(u->id), b); }
+    int buff_left(const PUnit *u, BuffType b) { return table.buff_left(table_row(u->id), b); } // -1 if off
     
     const int get_height(const Pos &p) const { return get_map().getHeight(p.x, p.y); }
 
     EUnit *get_e_unit(int id)
     {
         assert(get_p_unit(id)->camp != console->camp());
-        if (! eUnitObj.count(id))
-            eUnitObj[id] = new EUnit(id);
-        return eUnitObj[id];
+        return eUnitObj.get(id);
     }
 
     FUnit *get_f_unit(int id)
     {
         assert(get_p_unit(id)->camp == console->camp());
-        if (! fUnitObj.count(id))
-            fUnitObj[id] = new FUnit(id);
-        return fUnitObj[id];
+        return fUnitObj.get(id);
     }
 
-    PUnit *get_p_unit(int id) { return pUnits[id].first; }
+    PUnit *get_p_unit(int id) { return id < (int)pUnits.size() ? pUnits[id] : 0; }
     const std::vector<EGroup> &get_e_groups() const { return eGroups; }
     const std::vector<FGroup> &get_f_groups() const { return fGroups; }
     
-    double map_danger_factor(const Pos &p) const;
-
     int random(int x, int y)
     {
         std::uniform_int_distribution<int> distribution(x, y);
@@ -565,19 +1645,43 @@ public:
     }
 
     void log_mining() const;
+    void log_memo_stats() const;
+    void trace_round() const;
+    void trace_groups() const;
     void reg_mining(const Pos &p, int id);
     void del_mining(const Pos &p);
-    bool is_mining(const Pos &p) const { return mining.count(p); }
+    bool is_mining(const Pos &p) const { return ~mine_id(p) && ~mines[mine_id(p)].claimedBy; }
+    bool is_visible(int id) const { return id < (int)unitBlock.size() && ~unitBlock[id]; } // in info this round
+
+    bool out_of_time(double budget = ROUND_BUDGET) const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - roundStart).count() > budget;
+    }
     
-    int get_energy(const Pos &p) const { return mineEnergy.at(p); }
+    const std::vector<MineState> &get_mines() const { return mines; }
+    int get_energy(const Pos &p) const { return ~mine_id(p) ? (int) mines[mine_id(p)].energy : 0; }
     const EGroup *mine_visible(const Pos &p) const;
     
-    std::map<int, Pos> get_enemy_pos() const;
+    const std::vector<EnemyTrack> &get_enemy_tracks() const { return enemyKnown; }
+    const EnemyTrack *get_enemy_track(int id) const { return id >= 0 && id < (int)enemyTrack.size() && ~enemyTrack[id].round ? &enemyTrack[id] : 0; }
+    int count_enemy_tracks(const Pos &c, int r2) const; // of get_enemy_tracks, by the guessed positions
+    // where an enemy in a group this round is going next round, see EUnit::predict_pos. 0 if not predicted
+    float pressure(InfluenceLayer l, const Pos &p) const { return influence.at(l, p); } // of the grid cell of p
+    const Pos *get_predicted_pos(int id) const { return id >= 0 && id < (int)predictRound.size() && predictRound[id] == console->round() ? &predictPos[id] : 0; }
     
     void set_alarm() { alarm = console->round(); }
     bool alarmed() const { return ~alarm && console->round() - alarm <= ALARM_ROUND; }
     
-    Pos reachable(const FUnit *from, const Pos &to) const;
+    Pos reachable(const FUnit *from, const Pos &to);
+    const std::vector<float> &get_threat_cost();
+    // findShortestPath from start with safeBlocks, leaving the unit itself out. the closest it gets to dest
+    void safe_path(int id, const Pos &start, const Pos &dest, std::vector<Pos> &_path);
+
+    void use_safe_path(bool on) { safePath = on; } // whether the moves put from now on go by findSafePath
+    void put_order(const PUnit *unit, const PUnit *target, const Pos &pos) { orders.push_back(Order(unit, target, pos, safePath)); }
+    void apply_orders();
+    void keep_path(int id, const Pos &dest, const std::vector<Pos> &path);
+    bool kept_path(int id, const Pos &start, const Pos &dest, std::vector<Pos> &_path) const; // the rest of it from start, if start is on it
 
     void init(const PMap &_map, const PPlayerInfo &_info, PCommand &_cmd);
     void work();
@@ -610,24 +1714,14 @@ inline const FUnit *Character::get_unit() const
 
 void Character::attack(const EGroup &target)
 {
-    const EUnit *targetUnit(0);
+    const EUnit *targetUnit(get_unit()->get_belongs()->focus_target(get_unit(), target));
     double val(-INFINITY);
-    for (const EUnit *e : target.get_member())
-    {
-        int maxRange(sqr(sqrt(get_entity()->range) + get_entity()->findSkill("attack")->cd * sqrt(get_entity()->speed)));
-        if (dis2(get_entity()->pos, e->get_entity()->pos) > maxRange) continue;
-        if (lowerCase(e->get_entity()->name) == "observer" || lowerCase(e->get_entity()->name) == "mine") continue;
-        if (target.has_player() && (lowerCase(e->get_entity()->name) == "dragon" || lowerCase(e->get_entity()->name) == "roshan")) continue;
-        double _val = e->value_factor();
-        if (_val > val)
-            val = _val, targetUnit = e;
-    }
     if (! targetUnit)
         for (const EUnit *e : target.get_member())
         {
-            if (lowerCase(e->get_entity()->name) == "mine") continue;
-            if (target.has_player() && (lowerCase(e->get_entity()->name) == "dragon" || lowerCase(e->get_entity()->name) == "roshan")) continue;
-            if (get_entity()->range < e->get_entity()->range && e->get_entity()->findBuff("winordie")) continue;
+            if (e->get_kind() == KIND_MINE) continue;
+            if (target.has_player() && (kind_bit(e->get_kind()) & MONSTER_KINDS)) continue;
+            if (get_entity()->range < e->get_entity()->range && conductor.has_buff(e->get_entity(), BUFF_WINORDIE)) continue;
             double _val = e->value_factor();
             if (_val > val)
                 val = _val, targetUnit = e;
@@ -637,8 +1731,8 @@ void Character::attack(const EGroup &target)
         if (get_entity()->findSkill("attack")->cd >= 2)
         {
             const Pos _p(get_unit()->get_belongs()->center());
-            mylog << "UnitAction : Unit " << id << " : move(switch) " << _p << std::endl;
-            console->move(_p, get_entity());
+            RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : move(switch) " << _p << '\n';
+            get_unit()->order_move(_p);
         } else
         {
             const Pos target(targetUnit->predict_pos());
@@ -649,16 +1743,16 @@ void Character::attack(const EGroup &target)
                 Circle(target, sqr(sqrt(get_entity()->range) * 0.8)).contain(conductor.reachable(get_unit(), _p))
                )
             {
-                mylog << "UnitAction : Unit " << id << " : move(predict) " << _p << std::endl;
-                console->move(_p, get_entity());
+                RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : move(predict) " << _p << '\n';
+                get_unit()->order_move(_p);
             } else
             {
-                mylog << "UnitAction : Unit " << id << " : attack unit " << targetUnit->get_id() << std::endl;
-                console->attack(targetUnit->get_entity(), get_entity());
+                RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : attack unit " << targetUnit->get_id() << '\n';
+                get_unit()->order_attack(targetUnit->get_entity());
             }
         }
     } else
-        console->move(get_unit()->get_belongs()->center(), get_entity());
+        get_unit()->order_move(get_unit()->get_belongs()->center());
 }
 
 void Character::move(const Pos &p)
@@ -674,8 +1768,8 @@ void Character::move(const Pos &p)
         const EGroup *targetGroup = get_unit()->get_belongs()->in_battle();
         if (targetGroup && dis2(v1, Pos(0,0)) > get_entity()->view/8 && (v1.x * v2.x + v1.y * v2.y) / (dis(v1,Pos(0,0)) * dis(v2,Pos(0,0))) > cos(0.33 * pi))
         {
-            mylog << "UnitAction : Unit " << id << " : attack in move (1) " << std::endl;
-            if (lowerCase(get_entity()->name)=="master")
+            RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : attack in move (1) " << '\n';
+            if (get_unit()->get_kind() == KIND_MASTER)
                 Character::attack(*targetGroup); // no loop
             else
                 attack(*targetGroup);
@@ -684,58 +1778,45 @@ void Character::move(const Pos &p)
         bool ok(true);
         if (get_entity()->findSkill("attack")->cd == 0)
         {
-            UnitFilter filter;
-            filter.setAreaFilter(new Circle(get_entity()->pos, get_entity()->view), "a");
-            filter.setAvoidFilter("mine", "a");
-            filter.setAvoidFilter("observer", "a");
-            filter.setHpFilter(1, 0x7fffffff);
-            for (const PUnit *u : console->enemyUnits(filter))
+            const UnitIndex &index = conductor.get_index();
+            UnitQuery query;
+            query.enemy().avoid(KIND_MINE).avoid(KIND_OBSERVER).alive().not_reviving();
+            index.for_each(get_entity()->pos, get_entity()->view, query, [&](const PUnit *u)
             {
-                if (console->getBuff("reviving", u)) continue;
                 if (dis2(get_entity()->pos, u->pos) <= u->range)
-                {
                     ok = false;
-                    break;
-                }
-            }
+            });
             if (ok)
             {
                 const EUnit *targetUnit(NULL);
                 double val(-INFINITY);
-                filter.setAreaFilter(new Circle(get_entity()->pos, get_entity()->range), "w");
-                filter.setAvoidFilter("roshan", "a");
-                filter.setAvoidFilter("dragon", "a");
-                for (const PUnit *u : console->enemyUnits(filter))
+                query.kinds(~MONSTER_KINDS);
+                index.for_each(get_entity()->pos, get_entity()->range, query, [&](const PUnit *u)
                 {
-                    if (console->getBuff("reviving", u)) continue;
                     const EUnit *e = conductor.get_e_unit(u->id);
                     double _val = e->value_factor();
                     if (_val > val)
                         val = _val, targetUnit = e;
-                }
+                });
                 if (targetUnit)
                 {
-                    mylog << "UnitAction : Unit " << id << " : attack in move (2) " << std::endl;
-                    mylog << "UnitAction : Unit " << id << " : attack unit " << targetUnit->get_id() << std::endl;
-                    console->attack(targetUnit->get_entity(), get_entity());
+                    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : attack in move (2) " << '\n';
+                    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : attack unit " << targetUnit->get_id() << '\n';
+                    get_unit()->order_attack(targetUnit->get_entity());
                     return;
                 }
             }
         }
     }
     Pos _p(p);
-    UnitFilter filter;
-    filter.setAreaFilter(new Circle(get_entity()->pos, get_entity()->view * 1.2), "a");
-    filter.setAvoidFilter("mine", "a");
-    filter.setHpFilter(1, 0x7fffffff);
-    if (! console->enemyUnits(filter).empty())
+    if (conductor.get_index().any(get_entity()->pos, get_entity()->view * 1.2, UnitQuery().enemy().avoid(KIND_MINE).alive()))
     {
         Pos v1(get_unit()->get_belongs()->center() - get_entity()->pos), v2(p - get_entity()->pos);
         if (dis2(v1, Pos(0,0)) > get_entity()->view/4 && (v1.x * v2.x + v1.y * v2.y) / (dis(v1,Pos(0,0)) * dis(v2,Pos(0,0))) < cos(0.66 * pi))
             _p = get_unit()->get_belongs()->center();
     }
-    mylog << "UnitAction : Unit " << id << " : move " << _p << std::endl;
-    console->move(_p, get_entity());
+    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : move " << _p << '\n';
+    get_unit()->order_move(_p);
 }
 
 void HammerGuard::attack(const EGroup &target)
@@ -746,18 +1827,18 @@ void HammerGuard::attack(const EGroup &target)
         double val(-INFINITY);
         for (const EUnit *e : target.get_member())
         {
-            if (lowerCase(e->get_entity()->name) == "mine") continue;
-            if (lowerCase(e->get_entity()->name) == "militarybase") continue;
-            if (lowerCase(e->get_entity()->name) == "observer") continue;
-            if (e->get_entity()->findBuff("dizzy") && e->get_entity()->findBuff("dizzy")->timeLeft > 0) continue;
-            if (target.has_player() && (lowerCase(e->get_entity()->name) == "dragon" || lowerCase(e->get_entity()->name) == "roshan")) continue;
+            if (e->get_kind() == KIND_MINE) continue;
+            if (e->get_kind() == KIND_MILITARYBASE) continue;
+            if (e->get_kind() == KIND_OBSERVER) continue;
+            if (conductor.buff_left(e->get_entity(), BUFF_DIZZY) > 0) continue;
+            if (target.has_player() && (kind_bit(e->get_kind()) & MONSTER_KINDS)) continue;
             double _val = e->danger_factor();
             if (_val > val && dis2(get_entity()->pos, e->get_entity()->pos) <= HAMMERATTACK_RANGE)
                 val = _val, targetUnit = e;
         }
         if (targetUnit)
         {
-            mylog << "UnitAction : Unit " << id << " : hammerattack unit " << targetUnit->get_id() << std::endl;
+            RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : hammerattack unit " << targetUnit->get_id() << '\n';
             console->useSkill("hammerattack", targetUnit->get_entity(), get_entity());
         } else
             Character::attack(target);
@@ -771,7 +1852,7 @@ void Master::attack(const EGroup &target)
     bool near(false);
     for (const EUnit *e : target.get_member())
         if (
-            (lowerCase(e->get_entity()->name) == "hammerguard" || lowerCase(e->get_entity()->name) == "berserker") &&
+            (e->get_kind() == KIND_HAMMERGUARD || e->get_kind() == KIND_BERSERKER) &&
             dis2(get_entity()->pos, e->get_entity()->pos) <= e->get_entity()->range
            )
         {
@@ -784,7 +1865,7 @@ void Master::attack(const EGroup &target)
     
     if (dis2(get_entity()->pos, center) > CURE_RANGE/2)
     {
-        mylog << "UnitAction : Master " << id << " : cure team" << std::endl;
+        RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Master " << id << " : cure team" << '\n';
         move(center);
     }
     else if (near)
@@ -792,9 +1873,9 @@ void Master::attack(const EGroup &target)
         const Pos _p(get_entity()->pos + away);
         if (conductor.reachable(get_unit(), _p) == _p)
         {
-            mylog << "UnitAction : Master " << id << " : withdraw" << std::endl;
-            mylog << "UnitAction : Unit " << id << " : move " << _p << std::endl;
-            console->move(_p, get_entity()); // move directly
+            RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Master " << id << " : withdraw" << '\n';
+            RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : move " << _p << '\n';
+            get_unit()->order_move(_p); // move directly
         } else
             Character::attack(target);
     }
@@ -820,7 +1901,7 @@ void Master::move(const Pos &p)
     if (target != Pos(-1, -1))
     {
         Pos q(get_entity()->pos), _p(q+(target-q)*std::min(1.0, sqrt(BLINK_RANGE)/dis(target,q)));
-        mylog << "UnitAction : Unit " << id << " : blink " << _p << std::endl;
+        RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : blink " << _p << '\n';
         console->useSkill("blink", _p, get_entity());
     } else
         Character::move(p);
@@ -840,15 +1921,34 @@ void Berserker::attack(const EGroup &target)
         for (const EUnit *e : target.get_member())
         {
             if (dis2(get_entity()->pos, e->get_entity()->pos) > get_entity()->range) continue;
-            if (lowerCase(e->get_entity()->name) == "observer" || lowerCase(e->get_entity()->name) == "mine") continue;
-            if (target.has_player() && (lowerCase(e->get_entity()->name) == "dragon" || lowerCase(e->get_entity()->name) == "roshan")) continue;
+            if (e->get_kind() == KIND_OBSERVER || e->get_kind() == KIND_MINE) continue;
+            if (target.has_player() && (kind_bit(e->get_kind()) & MONSTER_KINDS)) continue;
             double _val = e->value_factor();
             if (_val > val)
                 val = _val, targetUnit = e;
         }
+        // sacrifice costs hp and doubles the damage taken as well, so only if the rollout of the fight says it pays
+        if (targetUnit && ! conductor.out_of_time())
+        {
+            const FGroup *g = get_unit()->get_belongs();
+            CombatState before, s;
+            g->combat_snapshot(before);
+            s = before;
+            const int i(s.find(id));
+            if (i != -1)
+            {
+                // the hp paid is a loss too, so it is scored from the hp before, like combat_outcome
+                s.unit[i].hp -= s.unit[i].atk, s.unit[i].winordie = COMBAT_SACRIFICE_ROUND;
+                if (combat_rollout(s, COMBAT_FIGHT, COMBAT_ROUND, &before).score() < g->combat_outcome(COMBAT_FIGHT).score())
+                {
+                    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : sacrifice does not pay" << '\n';
+                    targetUnit = 0;
+                }
+            }
+        }
         if (targetUnit)
         {
-            mylog << "UnitAction : Unit " << id << " : sacrifice" << std::endl;
+            RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : sacrifice" << '\n';
             console->useSkill("sacrifice", NULL, get_entity());
         } else
             Character::attack(target);
@@ -860,31 +1960,23 @@ void Scouter::move(const Pos &p)
 {
     if (get_entity()->mp >= SET_OBSERVER_MP && get_entity()->findSkill("setobserver")->cd == 0)
     {
-        UnitFilter filterMine;
-        filterMine.setAreaFilter(new Circle(get_entity()->pos, sqr(sqrt(SET_OBSERVER_RANGE)+sqrt(MINING_RANGE))), "a");
-        filterMine.setTypeFilter("mine", "a");
-        filterMine.setHpFilter(1, 0x7fffffff);
-        auto mines = console->enemyUnits(filterMine);
-        if (! mines.empty())
+        const UnitIndex &index = conductor.get_index();
+        const PUnit *mine = index.first(get_entity()->pos, sqr(sqrt(SET_OBSERVER_RANGE)+sqrt(MINING_RANGE)), UnitQuery().enemy().type(KIND_MINE).alive());
+        if (mine)
         {
-            UnitFilter filterEnemy;
-            filterEnemy.setAreaFilter(new Circle(mines.front()->pos, MINING_RANGE*2), "a");
-            filterEnemy.setAvoidFilter("mine", "a");
-            filterEnemy.setAvoidFilter("observer", "a");
-            filterEnemy.setAvoidFilter("roshan", "a");
-            filterEnemy.setAvoidFilter("dragon", "a");
-            filterEnemy.setHpFilter(1, 0x7fffffff);
+            UnitQuery enemy;
+            enemy.enemy().avoid(KIND_MINE).avoid(KIND_OBSERVER).kinds(~MONSTER_KINDS).alive();
             // the line below is different from Scouter::attack !!!
             if (
-                ! console->enemyUnits(filterEnemy).empty() ||
-                ! console->unitArg("energy", "c", mines.front()) && dis2(mines.front()->pos, p) > MINING_RANGE * 4
+                index.any(mine->pos, MINING_RANGE*2, enemy) ||
+                (! console->unitArg("energy", "c", mine) && dis2(mine->pos, p) > MINING_RANGE * 4)
                )
             {
                 int cnt(0);
                 Pos _p;
                 do
                 {
-                    _p = console->randPosInArea(mines.front()->pos, MINING_RANGE), cnt++;
+                    _p = console->randPosInArea(mine->pos, MINING_RANGE), cnt++;
                     if (cnt > 10) break;
                 }
                 while (
@@ -893,7 +1985,7 @@ void Scouter::move(const Pos &p)
                       );
                 if (Circle(get_entity()->pos, SET_OBSERVER_RANGE).contain(_p))
                 {
-                    mylog << "UnitAction : Unit " << id << " : set observer " << _p << std::endl;
+                    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : set observer " << _p << '\n';
                     console->useSkill("setobserver", _p, get_entity());
                 } else
                     Character::move(p);
@@ -909,27 +2001,19 @@ void Scouter::attack(const EGroup &target)
 {
     if (get_entity()->mp >= SET_OBSERVER_MP && get_entity()->findSkill("setobserver")->cd == 0)
     {
-        UnitFilter filterMine;
-        filterMine.setAreaFilter(new Circle(get_entity()->pos, sqr(sqrt(SET_OBSERVER_RANGE)+sqrt(MINING_RANGE))), "a");
-        filterMine.setTypeFilter("mine", "a");
-        filterMine.setHpFilter(1, 0x7fffffff);
-        auto mines = console->enemyUnits(filterMine);
-        if (! mines.empty())
+        const UnitIndex &index = conductor.get_index();
+        const PUnit *mine = index.first(get_entity()->pos, sqr(sqrt(SET_OBSERVER_RANGE)+sqrt(MINING_RANGE)), UnitQuery().enemy().type(KIND_MINE).alive());
+        if (mine)
         {
-            UnitFilter filterEnemy;
-            filterEnemy.setAreaFilter(new Circle(mines.front()->pos, MINING_RANGE), "a");
-            filterEnemy.setAvoidFilter("mine", "a");
-            filterEnemy.setAvoidFilter("observer", "a");
-            filterEnemy.setAvoidFilter("roshan", "a");
-            filterEnemy.setAvoidFilter("dragon", "a");
-            filterEnemy.setHpFilter(1, 0x7fffffff);
-            if (! console->enemyUnits(filterEnemy).empty())
+            UnitQuery enemy;
+            enemy.enemy().avoid(KIND_MINE).avoid(KIND_OBSERVER).kinds(~MONSTER_KINDS).alive();
+            if (index.any(mine->pos, MINING_RANGE, enemy))
             {
                 int cnt(0);
                 Pos _p;
                 do
                 {
-                    _p = console->randPosInArea(mines.front()->pos, MINING_RANGE), cnt++;
+                    _p = console->randPosInArea(mine->pos, MINING_RANGE), cnt++;
                     if (cnt > 10) break;
                 }
                 while (
@@ -938,7 +2022,7 @@ void Scouter::attack(const EGroup &target)
                       );
                 if (Circle(get_entity()->pos, SET_OBSERVER_RANGE).contain(_p))
                 {
-                    mylog << "UnitAction : Unit " << id << " : set observer " << _p << std::endl;
+                    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : set observer " << _p << '\n';
                     console->useSkill("setobserver", _p, get_entity());
                 } else
                     Character::attack(target);
@@ -956,19 +2040,18 @@ void Scouter::attack(const EGroup &target)
 
 template <class CampGroup, class CampUnit>
 Unit<CampGroup, CampUnit>::Unit(int _id)
-    : id(_id), belongs(0)
-{
-    std::string name = lowerCase(conductor.get_p_unit(id)->name);
-    if (name == "hammerguard")
-        character = new HammerGuard(id);
-    else if (name == "master")
-        character = new Master(id);
-    else if (name == "berserker")
-        character = new Berserker(id);
-    else if (name == "scouter")
-        character = new Scouter(id);
-    else
-        character = new Character(id);
+    : id(_id), kind(unit_kind(conductor.get_p_unit(_id))), belongs(0)
+{
+    static_assert(sizeof(HammerGuard) == sizeof(Character) && sizeof(Master) == sizeof(Character) &&
+                  sizeof(Berserker) == sizeof(Character) && sizeof(Scouter) == sizeof(Character), "characters must fit in characterCell");
+    switch (kind)
+    {
+    case KIND_HAMMERGUARD: character = new (&characterCell) HammerGuard(id); break;
+    case KIND_MASTER: character = new (&characterCell) Master(id); break;
+    case KIND_BERSERKER: character = new (&characterCell) Berserker(id); break;
+    case KIND_SCOUTER: character = new (&characterCell) Scouter(id); break;
+    default: character = new (&characterCell) Character(id);
+    }
 }
 
 template <class CampGroup, class CampUnit>
@@ -986,69 +2069,35 @@ inline const PUnit *Unit<CampGroup, CampUnit>::get_entity() const
 template <class CampGroup, class CampUnit>
 double Unit<CampGroup, CampUnit>::strength_factor() const
 {
-    CACHE_BEGIN(double);
-    if (lowerCase(get_entity()->name) == "mine") return 0;
-    
-    double val(0), ava(0), tot(0);
-
-    console->selectUnit(get_entity());
-
-    if (lowerCase(get_entity()->name) == "observer")
-    {
-        ava += std::max(console->unitArg("hp","c"), 0) * HP_STRENGTH_FACTOR * OBSERVER_FACTOR_RATE;
-        tot += console->unitArg("hp","m") * HP_STRENGTH_FACTOR;
-        val += console->unitArg("def","c") * DEF_STRENGTH_FACTOR;
-    } else
-    {
-        if (console->getBuff("winordie", get_entity()))
-            ava += std::max(console->unitArg("hp","m"), 0) * HP_STRENGTH_FACTOR;
-        else
-            ava += std::max(console->unitArg("hp","c"), 0) * HP_STRENGTH_FACTOR;
-        tot += console->unitArg("hp","m") * HP_STRENGTH_FACTOR;
-        val += console->unitArg("hp", "r") * HP_RATE_STRENGTH_FACTOR;
-        if (get_entity()->isHero())
-        {
-            ava += std::max(console->unitArg("mp","c"), 0) * MP_STRENGTH_FACTOR;
-            tot += console->unitArg("mp","m") * MP_STRENGTH_FACTOR;
-            val += console->unitArg("mp", "r") * MP_RATE_STRENGTH_FACTOR;
-        }
-        val += console->unitArg("atk","c") * ATK_STRENGTH_FACTOR;
-        val += console->unitArg("def","c") * DEF_STRENGTH_FACTOR;
-        if (! get_entity()->isBase() && ! get_entity()->isMine())
-            val += console->unitArg("speed","c") * SPEED_STRENGTH_FACTOR;
-    }
-    console->selectUnit(0);
-
-    CACHE_END(val * ava / tot);
+    return conductor.get_table().strength[conductor.table_row(id)];
 }
 
 int EUnit::cover_by_num() const
 {
-    CACHE_BEGIN(int);
+    static Memo<int> memo("EUnit::cover_by_num");
+    if (const int *ret = memo.find(id)) return *ret;
+    const UnitIndex &index = conductor.get_index();
+    const Pos &p = get_entity()->pos;
     int ret(0);
-    UnitFilter filter;
-    filter.setTypeFilter("master", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, MASTER_RANGE), "w");
-    ret += console->friendlyUnits(filter).size();
-    filter.setTypeFilter("berserker", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, BERSERKER_RANGE), "w");
-    ret += console->friendlyUnits(filter).size();
-    filter.setTypeFilter("scouter", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, SCOUTER_RANGE), "w");
-    ret += console->friendlyUnits(filter).size();
-    filter.setTypeFilter("hammerguard", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, HAMMERGUARD_RANGE), "w");
-    ret += console->friendlyUnits(filter).size();
-    CACHE_END(ret);
+    ret += index.count(p, MASTER_RANGE, UnitQuery().friendly().type(KIND_MASTER));
+    ret += index.count(p, BERSERKER_RANGE, UnitQuery().friendly().type(KIND_BERSERKER));
+    ret += index.count(p, SCOUTER_RANGE, UnitQuery().friendly().type(KIND_SCOUTER));
+    ret += index.count(p, HAMMERGUARD_RANGE, UnitQuery().friendly().type(KIND_HAMMERGUARD));
+    return memo.store(id, ret);
 }
 
 bool EUnit::ready_for(const FUnit *u, const char *skill, int range) const
 {
-    int dizzy(get_entity()->findBuff("dizzy") ? get_entity()->findBuff("dizzy")->timeLeft : -1);
-    if (dizzy >= 1) return false;
+    // `range` follows from `skill` at every call site, so it is not a part of the key
+    static Memo<bool> memo("EUnit::ready_for");
+    const int param = u->get_id() * 2 + (strcmp(skill, "attack") != 0);
+    if (const bool *ret = memo.find(id, param)) return *ret;
+    
+    int dizzy(conductor.buff_left(get_entity(), BUFF_DIZZY));
+    if (dizzy >= 1) return memo.store(id, param, false);
     int cd(get_entity()->findSkill(skill) ? get_entity()->findSkill(skill)->cd : 100);
     if (dizzy == 0 && cd == 0) cd = 1;
-    if (cd > 0) return false;
+    if (cd > 0) return memo.store(id, param, false);
     
     const PArg *arg = (*(u->get_entity()))["lasthit"];
     if (arg)
@@ -1057,153 +2106,94 @@ bool EUnit::ready_for(const FUnit *u, const char *skill, int range) const
         assert(id >= 0);
         if (val.size() > id && val.at(id) >= console->round() - get_entity()->findSkill("attack")->maxCd)
         {
-            mylog << "UnitStatus : EUnit : " << id << " attacked " << u->get_id() << " last cycle" << std::endl;
-            return true;
+            RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : EUnit : " << id << " attacked " << u->get_id() << " last cycle" << '\n';
+            return memo.store(id, param, true);
         }
     }
     
-    UnitFilter filter;
-    filter.setHpFilter(1, 0x7fffffff);
-    filter.setAreaFilter(new Circle(get_entity()->pos, range), "a");
-    filter.setAvoidFilter("mine", "a");
-    if (console->friendlyUnits(filter).size() <= 2)
+    if (conductor.get_index().count(get_entity()->pos, range, UnitQuery().friendly().avoid(KIND_MINE).alive()) <= 2)
     {
-        mylog << "UnitStatus : EUnit : " << id << " has <=2 targets" << std::endl;
-        return true;
+        RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : EUnit : " << id << " has <=2 targets" << '\n';
+        return memo.store(id, param, true);
     }
-    return false;
+    return memo.store(id, param, false);
 }
 
 Pos EUnit::predict_pos() const
 {
-    CACHE_BEGIN(Pos);
-    if (get_entity()->findBuff("dizzy"))
-    {
-        mylog << "UnitStatus : EUnit : " << id << " cannot move" << std::endl;
-        CACHE_END(get_entity()->pos);
-    }
-    UnitFilter rangeFilter;
-    rangeFilter.setHpFilter(1, 0x7fffffff);
-    rangeFilter.setAvoidFilter("mine", "a");
-    rangeFilter.setAreaFilter(new Circle(get_entity()->pos, get_entity()->range), "a");
-    if (! console->friendlyUnits(rangeFilter).empty())
-    {
-        mylog << "UnitStatus : EUnit : " << id << " is likely to stand still" << std::endl;
-        CACHE_END(get_entity()->pos);
-    }
-    
-    UnitFilter viewFilter;
-    viewFilter.setHpFilter(1, 0x7fffffff);
-    viewFilter.setAvoidFilter("mine", "a");
-    for (const EUnit *e : belongs->get_member())
-        viewFilter.setAreaFilter(new Circle(e->get_entity()->pos, e->get_entity()->view), "a");
-    const auto &inSight = console->friendlyUnits(viewFilter);
-    if (! inSight.empty())
-    {
-        Pos target(0, 0);
-        double minDis(sqrt(get_entity()->speed));
-        for (const PUnit *u : inSight)
-            minDis = std::min(minDis, dis(get_entity()->pos, u->pos));
-        for (const PUnit *u : inSight)
-            target += (u->pos - get_entity()->pos) * (minDis / dis(get_entity()->pos, u->pos));
-        target = get_entity()->pos + target * (1.0 / inSight.size());
-        mylog << "UnitStatus : EUnit : " << id << " is likely to move to " << target << std::endl;
-        CACHE_END(target);
-    }
-    
-    CACHE_END(get_entity()->pos);
+    const Pos *ret = conductor.get_predicted_pos(id);
+    return ret ? *ret : get_entity()->pos;
+}
+
+double EUnit::danger_factor() const
+{
+    double ret = strength_factor() * DANGER_FACTOR;
+    if (conductor.has_buff(get_entity(), BUFF_WINORDIE)) ret *= WINORDIE_DANGER_RATE;
+    return ret;
 }
 
 double EUnit::value_factor() const
 {
-    CACHE_BEGIN(double);
-    if (lowerCase(get_entity()->name) == "mine") return 0;
+    if (kind == KIND_MINE) return 0;
+    const UnitTable &table = conductor.get_table();
+    const int r(conductor.table_row(id));
     
-    double danger(0), hp(0), def(0);
-
-    console->selectUnit(get_entity());
-
-    if (lowerCase(get_entity()->name) == "observer")
-    {
-        hp += std::max(console->unitArg("hp","c"), 0) * HP_VALUE_FACTOR;
-        def += console->unitArg("def","c") * DEF_VALUE_FACTOR;
-    } else
-    {
-        hp += std::max(console->unitArg("hp","c"), 0) * HP_VALUE_FACTOR;
-        if (get_entity()->isHero())
-        {
-            danger += std::max(console->unitArg("mp","c"), 0) * MP_VALUE_FACTOR;
-        }
-        danger += console->unitArg("atk","c") * ATK_VALUE_FACTOR;
-        def += console->unitArg("def","c") * DEF_VALUE_FACTOR;
+    double danger(table.valueDanger[r]);
+    if (kind != KIND_OBSERVER)
         danger += cover_by_num() * COVER_VALUE_FACTOR;
-    }
-    if (console->getBuff("dizzy", get_entity())) danger *= DIZZY_VALUE_RATE;
-    if (console->getBuff("waitrevive", get_entity())) danger *= WAITREVIVE_VALUE_RATE;
-    if (console->getBuff("winordie", get_entity())) danger *= WINORDIE_VALUE_RATE;
-    if (console->getBuff("ismining", get_entity())) danger *= ISMINING_VALUE_RATE;
+    if (table.has_buff(r, BUFF_DIZZY)) danger *= DIZZY_VALUE_RATE;
+    if (table.has_buff(r, BUFF_WAITREVIVE)) danger *= WAITREVIVE_VALUE_RATE;
+    if (table.has_buff(r, BUFF_WINORDIE)) danger *= WINORDIE_VALUE_RATE;
+    if (table.has_buff(r, BUFF_ISMINING)) danger *= ISMINING_VALUE_RATE;
 
-    console->selectUnit(0);
-
-    CACHE_END(danger / inf_1(hp * def / 5000));
+    return danger / table.valueDiv[r];
 }
 
 int FUnit::cover_by_ready_num() const
 {
-    CACHE_BEGIN(int);
+    static Memo<int> memo("FUnit::cover_by_ready_num");
+    if (const int *ret = memo.find(id)) return *ret;
+    // ownRange: pass the attacker's range to ready_for instead of `range`
+    static const struct { UnitKind kind; int range; const char *skill; bool ownRange; } threats[] = {
+        { KIND_MASTER, MASTER_RANGE, "attack", true },
+        { KIND_BERSERKER, BERSERKER_RANGE, "attack", true }, // not considering level
+        { KIND_SCOUTER, SCOUTER_RANGE, "attack", true },
+        { KIND_HAMMERGUARD, HAMMERGUARD_RANGE, "attack", true },
+        { KIND_HAMMERGUARD, HAMMERATTACK_RANGE, "hammerattack", false },
+        { KIND_ROSHAN, Roshan_RANGE, "attack", true },
+        { KIND_DRAGON, Dragon_RANGE, "attack", true }
+    };
     int ret(0);
-    UnitFilter filter;
-    filter.setHpFilter(1, 0x7fffffff);
-    filter.setTypeFilter("master", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, MASTER_RANGE), "w");
-    for (const auto e : console->enemyUnits(filter))
-        ret += (conductor.get_e_unit(e->id)->ready_for(this, "attack", e->range));
-    filter.setTypeFilter("berserker", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, BERSERKER_RANGE), "w"); // not considering level
-    for (const auto e : console->enemyUnits(filter))
-        ret += (conductor.get_e_unit(e->id)->ready_for(this, "attack", e->range));
-    filter.setTypeFilter("scouter", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, SCOUTER_RANGE), "w");
-    for (const auto e : console->enemyUnits(filter))
-        ret += (conductor.get_e_unit(e->id)->ready_for(this, "attack", e->range));
-    filter.setTypeFilter("hammerguard", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, HAMMERGUARD_RANGE), "w");
-    for (const auto e : console->enemyUnits(filter))
-        ret += (conductor.get_e_unit(e->id)->ready_for(this, "attack", e->range));
-    filter.setTypeFilter("hammerguard", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, HAMMERATTACK_RANGE), "w");
-    for (const auto e : console->enemyUnits(filter))
-        ret += (conductor.get_e_unit(e->id)->ready_for(this, "hammerattack", HAMMERATTACK_RANGE));
-    filter.setTypeFilter("roshan", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, Roshan_RANGE), "w");
-    for (const auto e : console->enemyUnits(filter))
-        ret += (conductor.get_e_unit(e->id)->ready_for(this, "attack", e->range));
-    filter.setTypeFilter("dragon", "w");
-    filter.setAreaFilter(new Circle(get_entity()->pos, Dragon_RANGE), "w");
-    for (const auto e : console->enemyUnits(filter))
-        ret += (conductor.get_e_unit(e->id)->ready_for(this, "attack", e->range));
-    CACHE_END(ret);
+    for (const auto &t : threats)
+        conductor.get_index().for_each(get_entity()->pos, t.range, UnitQuery().enemy().type(t.kind).alive(), [&](const PUnit *e)
+        {
+            ret += (conductor.get_e_unit(e->id)->ready_for(this, t.skill, t.ownRange ? e->range : t.range));
+        });
+    return memo.store(id, ret);
 }
 
 double FUnit::health_factor() const
 {
-    if (console->getBuff("winordie", get_entity())) return 1.0;
-    return (double)std::max(console->unitArg("hp","c",get_entity()), 0) / console->unitArg("hp","m",get_entity());
+    const UnitTable &table = conductor.get_table();
+    const int r(conductor.table_row(id));
+    if (table.has_buff(r, BUFF_WINORDIE)) return 1.0;
+    return std::max(table.hp[r], 0.0) / table.maxHp[r];
 }
 
 const EUnit *FUnit::last_attack_by() const
 {
-    CACHE_BEGIN(const EUnit*);
+    static Memo<const EUnit*> memo("FUnit::last_attack_by");
+    if (const EUnit *const *ret = memo.find(id)) return *ret;
     if (! (*get_entity())["lasthit"])
     {
-        mylog << "WARNING : FUnit " << id << " : no arg lasthit" << std::endl;
-        CACHE_END(NULL);
+        RD_LOG(LOG_WARNING) << "WARNING : FUnit " << id << " : no arg lasthit" << '\n';
+        return memo.store(id, NULL);
     }
     int eid(-1), round(-1);
     const std::vector<int> &data = (*get_entity())["lasthit"]->val;
-    for (const auto &x : conductor.get_enemy_pos())
+    for (const EnemyTrack &t : conductor.get_enemy_tracks())
     {
-        int _eid = x.first;
+        int _eid = t.id;
         assert(_eid >= 0);
         int _round = (data.size() > _eid ? data.at(_eid) : -1);
         if (_round > round)
@@ -1211,47 +2201,86 @@ const EUnit *FUnit::last_attack_by() const
     }
     if (!~eid)
     {
-        mylog << "WARNING : FUnit " << id << " : no recorded attack" << std::endl;
-        CACHE_END(NULL);
+        RD_LOG(LOG_WARNING) << "WARNING : FUnit " << id << " : no recorded attack" << '\n';
+        return memo.store(id, NULL);
     }
-    mylog << "UnitStatus : Unit " << id << " : last attacked by unit " << eid << std::endl;
-    CACHE_END(conductor.get_e_unit(eid));
+    RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : Unit " << id << " : last attacked by unit " << eid << '\n';
+    return memo.store(id, conductor.get_e_unit(eid));
 }
 
 EUnit::EUnit(int _id)
     : Unit<EGroup, EUnit>(_id) {}
 
 FUnit::FUnit(int _id)
-    : Unit<FGroup, FUnit>(_id), madeAction(-1) {}
+    : Unit<FGroup, FUnit>(_id), madeAction(-1), lastTarget(-1), lastPos(-1, -1) {}
 
 bool FUnit::escape_sacrifice()
 {
-    UnitFilter filter;
-    filter.setHpFilter(1, 0x7fffffff);
-    filter.setTypeFilter("berserker", "a");
+    const UnitIndex &index = conductor.get_index();
+    UnitQuery query;
+    query.enemy().type(KIND_BERSERKER).alive();
     Pos away(0, 0);
-    for (const PUnit *u : console->enemyUnits(filter))
-        if (dis2(u->pos, get_entity()->pos) <= u->range && u->findBuff("winordie") && ! u->findBuff("dizzy"))
+    index.for_each(query, [&](const PUnit *u)
+    {
+        if (dis2(u->pos, get_entity()->pos) <= u->range && conductor.has_buff(u, BUFF_WINORDIE) && ! conductor.has_buff(u, BUFF_DIZZY))
             away -= u->pos - get_entity()->pos;
+    });
     if (away == Pos(0, 0)) return false;
     away = get_entity()->pos + away * (sqrt(get_entity()->speed) / dis(away, Pos(0, 0)));
     const Pos _p = conductor.reachable(this, away);
-    for (const PUnit *u : console->enemyUnits(filter))
-        if (dis2(u->pos, _p) <= u->range && u->findBuff("winordie") && ! u->findBuff("dizzy"))
-            return false;
-    mylog << "UnitAction : Unit " << id << " : move(escape sacrifice) " << away << std::endl;
-    console->move(away, get_entity());
+    bool caught(false);
+    index.for_each(query, [&](const PUnit *u)
+    {
+        if (dis2(u->pos, _p) <= u->range && conductor.has_buff(u, BUFF_WINORDIE) && ! conductor.has_buff(u, BUFF_DIZZY))
+            caught = true;
+    });
+    if (caught) return false;
+    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : move(escape sacrifice) " << away << '\n';
+    order_move(away);
     madeAction = console->round();
     return true;
 }
 
+void FUnit::order_move(const Pos &p)
+{
+    conductor.put_order(get_entity(), 0, p);
+    lastTarget = -1, lastPos = p;
+}
+
+void FUnit::order_attack(const PUnit *target)
+{
+    conductor.put_order(get_entity(), target, target->pos);
+    lastTarget = target->id;
+}
+
+void FUnit::repeat_order()
+{
+    if (madeAction == console->round()) return;
+    if (~lastTarget && conductor.is_visible(lastTarget) && conductor.get_p_unit(lastTarget)->hp >= 1)
+    {
+        RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : repeat attack unit " << lastTarget << '\n';
+        conductor.put_order(get_entity(), conductor.get_p_unit(lastTarget), conductor.get_p_unit(lastTarget)->pos);
+    } else if (lastPos != Pos(-1, -1))
+    {
+        RD_LOG(LOG_UNIT_ACTION) << "UnitAction : Unit " << id << " : repeat move " << lastPos << '\n';
+        conductor.put_order(get_entity(), 0, lastPos);
+    }
+    madeAction = console->round();
+}
+
 void FUnit::attack(const EGroup &target)
 {
     if (escape_sacrifice()) return;
     
     if (madeAction == console->round())
     {
-        mylog << "WARNING : Unit " << id << " : multiple command" << std::endl;
+        RD_LOG(LOG_WARNING) << "WARNING : Unit " << id << " : multiple command" << '\n';
+        return;
+    }
+    
+    if (conductor.out_of_time()) // a single group can take tens of ms, so check per unit too
+    {
+        repeat_order();
         return;
     }
     
@@ -1266,11 +2295,17 @@ void FUnit::move(const Pos &p)
     
     if (madeAction == console->round())
     {
-        mylog << "WARNING : Unit " << id << " : multiple command" << std::endl;
+        RD_LOG(LOG_WARNING) << "WARNING : Unit " << id << " : multiple command" << '\n';
+        return;
+    }
+    
+    if (conductor.out_of_time()) // a single group can take tens of ms, so check per unit too
+    {
+        repeat_order();
         return;
     }
     
-    if (conductor.mine_visible(p) && console->getBuff("ismining", get_entity()))
+    if (conductor.mine_visible(p) && conductor.has_buff(get_entity(), BUFF_ISMINING))
         mine(*(conductor.mine_visible(p)));
     else
         character->move(p);
@@ -1284,16 +2319,22 @@ void FUnit::mine(const EGroup &target)
     
     if (madeAction == console->round())
     {
-        mylog << "WARNING : Unit " << id << " : multiple command" << std::endl;
+        RD_LOG(LOG_WARNING) << "WARNING : Unit " << id << " : multiple command" << '\n';
+        return;
+    }
+    
+    if (conductor.out_of_time()) // a single group can take tens of ms, so check per unit too
+    {
+        repeat_order();
         return;
     }
     
     auto member = target.get_member();
-    if (member.size() == 1 && lowerCase(member.front()->get_entity()->name) == "mine")
+    if (member.size() == 1 && member.front()->get_kind() == KIND_MINE)
     {
-        console->changeShortestPathFunc(findSafePath);
+        conductor.use_safe_path(true);
         character->move(member.front()->get_entity()->pos);
-        console->changeShortestPathFunc(findShortestPath);
+        conductor.use_safe_path(false);
     } else
         character->attack(target);
     
@@ -1316,145 +2357,196 @@ void Group<CampGroup, CampUnit>::add_member(CampUnit *unit)
 {
     member.push_back(unit);
     idSet.insert(unit->id);
+    kindMask |= kind_bit(unit->kind);
     unit->belongs = (CampGroup*)this;
 }
 
-void EGroup::add_adj_members_recur(EUnit *unit)
+template <class CampGroup, class CampUnit>
+void Group<CampGroup, CampUnit>::clear_member()
 {
-    add_member(unit);
-    UnitFilter filter;
-    filter.setAreaFilter(new Circle(unit->get_entity()->pos, ENEMY_JOIN_DIS2), "a");
-    filter.setHpFilter(1, 0x7fffffff);
-    // including mine
-    for (const PUnit *item : console->enemyUnits(filter))
-        if (! console->getBuff("reviving", item) && ! idExist(item->id))
-            add_adj_members_recur(conductor.get_e_unit(item->id));
+    for (CampUnit *u : member)
+        u->belongs = 0;
+    member.clear(), idSet.clear(), kindMask = 0;
 }
 
 template <class CampGroup, class CampUnit>
-bool Group<CampGroup, CampUnit>::has_type(const std::string &s) const
+void Group<CampGroup, CampUnit>::update_kind_mask()
 {
+    kindMask = 0;
     for (CampUnit *u : member)
-        if (lowerCase(u->get_entity()->name) == s) return true;
-    return false;
+        kindMask |= kind_bit(u->kind);
 }
 
 template <class CampGroup, class CampUnit>
 void Group<CampGroup, CampUnit>::logMsg() const
 {
+    if (! log_on(LOG_GROUP_MEMBER)) return;
     mylog << "GroupMember : " << typeid(CampGroup).name() << " : Group " << groupId << " : { ";
     for (const CampUnit *u : member)
         mylog << u->id << ", ";
-    mylog << "}" << std::endl;
+    mylog << "}" << '\n';
 }
 
 void EGroup::logMsg() const
 {
     Group<EGroup, EUnit>::logMsg();
-    mylog << "GroupStatus : EGroup : Group " << groupId << " mine_factor = " << mine_factor() << std::endl;
+    RD_LOG(LOG_GROUP_STATUS) << "GroupStatus : EGroup : Group " << groupId << " age = " << console->round() - foundRound << '\n';
+    RD_LOG(LOG_GROUP_STATUS) << "GroupStatus : EGroup : Group " << groupId << " mine_factor = " << mine_factor() << '\n';
 }
 
 double EGroup::danger_factor() const
 {
-    CACHE_BEGIN(double);
+    static Memo<double> memo("EGroup::danger_factor");
+    if (const double *ret = memo.find(memo_key())) return *ret;
     double ret(0);
     for (const EUnit *e : member)
         ret += e->danger_factor();
-    CACHE_END(inf_1(ret / 200));
+    return memo.store(memo_key(), inf_1(ret / 200));
 }
 
 double FGroup::ability_factor() const
 {
-    CACHE_BEGIN(double);
+    static Memo<double> memo("FGroup::ability_factor");
+    if (const double *ret = memo.find(memo_key())) return *ret;
     double ret(0);
     for (const FUnit *e : member)
         ret += e->ability_factor();
-    CACHE_END(inf_1(ret / 200));
+    return memo.store(memo_key(), inf_1(ret / 200));
 }
 
 double FGroup::health_factor() const
 {
-    CACHE_BEGIN(double);
+    static Memo<double> memo("FGroup::health_factor");
+    if (const double *ret = memo.find(memo_key())) return *ret;
+    const UnitTable &table = conductor.get_table();
     double tc(0), tm(0);
     for (const FUnit *e : member)
     {
-        tc += std::max(console->unitArg("hp","c",e->get_entity()), 0);
-        tm += console->unitArg("hp","m",e->get_entity());
+        const int r(conductor.table_row(e->id));
+        tc += std::max(table.hp[r], 0.0);
+        tm += table.maxHp[r];
     }
-    CACHE_END(tc / tm);
+    return memo.store(memo_key(), tc / tm);
 }
 
 double FGroup::surround_factor() const
 {
-    CACHE_BEGIN(double);
+    static Memo<double> memo("FGroup::surround_factor");
+    if (const double *ret = memo.find(memo_key())) return *ret;
+    // our ability against every enemy group any member sees. whole groups count, not the pressure
+    // of the influence map at a cell, which only has the units near it
     double fri(0), ene(0);
     std::set<int> flag;
     for (const FUnit *e : member)
     {
         fri += e->ability_factor();
-        UnitFilter filter;
-        filter.setAreaFilter(new Circle(e->get_entity()->pos, e->get_entity()->view), "a");
-        filter.setAvoidFilter("mine");
-        filter.setHpFilter(1, 0x7fffffff);
-        for (const PUnit *u : console->enemyUnits(filter))
+        conductor.get_index().for_each(e->get_entity()->pos, e->get_entity()->view, UnitQuery().enemy().avoid(KIND_MINE).alive().not_reviving(), [&](const PUnit *u)
         {
-            if (console->getBuff("reviving", u)) continue;
             const EGroup *g = conductor.get_e_unit(u->id)->get_belongs();
-            if (flag.count(g->groupId)) continue;
+            if (flag.count(g->groupId)) return;
             flag.insert(g->groupId);
-            for (const EUnit *e : g->get_member())
-                ene += e->danger_factor();
-        }
+            for (const EUnit *_e : g->get_member())
+                ene += _e->danger_factor();
+        });
     }
-    CACHE_END(fri / ene);
+    return memo.store(memo_key(), ene > 0 ? std::min(fri / ene, SURROUND_FACTOR_CAP) : SURROUND_FACTOR_CAP);
+}
+
+bool combat_add(CombatState &s, const PUnit *p, bool enemy)
+{
+    const UnitTable &table = conductor.get_table();
+    const int r(conductor.table_row(p->id));
+    if (table.hp[r] <= 0 || table.has_buff(r, BUFF_WAITREVIVE) || table.has_buff(r, BUFF_REVIVING)) return false;
+    CombatUnit *c = s.add();
+    if (! c) return false;
+    const PSkill *attack = p->findSkill("attack");
+    c->id = p->id, c->enemy = enemy;
+    c->x = p->pos.x, c->y = p->pos.y;
+    c->hp = table.hp[r], c->atk = attack ? table.atk[r] : 0, c->def = table.def[r];
+    c->step = table.moves[r] && ! (kind_bit(table.kind[r]) & MONSTER_KINDS) ? sqrt(table.speed[r]) : 0;
+    c->range2 = p->range;
+    c->weight = table.strength[r];
+    c->cd = attack ? attack->cd : 0, c->maxCd = attack ? std::max(attack->maxCd, 1) : 1;
+    c->dizzy = std::max(table.buff_left(r, BUFF_DIZZY), 0), c->winordie = std::max(table.buff_left(r, BUFF_WINORDIE), 0);
+    return true;
+}
+
+void FGroup::combat_snapshot(CombatState &s) const
+{
+    s.n = 0;
+    s.homeX = MILITARY_BASE_POS[console->camp()].x, s.homeY = MILITARY_BASE_POS[console->camp()].y;
+    for (const FUnit *u : member)
+        combat_add(s, u->get_entity(), false);
+    std::set<int> flag;
+    for (const FUnit *u : member)
+        conductor.get_index().for_each(u->get_entity()->pos, u->get_entity()->view, UnitQuery().enemy().avoid(KIND_MINE).alive().not_reviving(), [&](const PUnit *p)
+        {
+            const EGroup *g = conductor.get_e_unit(p->id)->get_belongs();
+            if (flag.count(g->groupId)) return;
+            flag.insert(g->groupId);
+            for (const EUnit *e : g->get_member())
+                if (e->get_kind() != KIND_MINE && e->get_kind() != KIND_OBSERVER)
+                    combat_add(s, e->get_entity(), true);
+        });
+}
+
+CombatOutcome FGroup::combat_outcome(CombatPolicy policy) const
+{
+    static Memo<CombatOutcome> memo("FGroup::combat_outcome");
+    if (const CombatOutcome *ret = memo.find(memo_key(), policy)) return *ret;
+    RD_PROFILE_SCOPE("FGroup::combat_outcome");
+    CombatState s;
+    combat_snapshot(s);
+    return memo.store(memo_key(), policy, combat_rollout(s, policy));
 }
 
 const EGroup *FGroup::in_battle() const
 {
-    CACHE_BEGIN(const EGroup*);
+    static Memo<const EGroup*> memo("FGroup::in_battle");
+    if (const EGroup *const *ret = memo.find(memo_key())) return *ret;
     for (FUnit *u : member)
-       if (console->getBuff("beattacked", u->get_entity()))
+       if (conductor.has_buff(u->get_entity(), BUFF_BEATTACKED))
        {
            const EUnit *e = u->last_attack_by();
            // hitting by base will not be recorded
            if (e)
            {
-               mylog << "GroupStatus : FGroup : Group " << groupId << " : in battle" << std::endl;
-               CACHE_END(e->get_belongs());
+               RD_LOG(LOG_GROUP_STATUS) << "GroupStatus : FGroup : Group " << groupId << " : in battle" << '\n';
+               return memo.store(memo_key(), e->get_belongs());
            }
        }
-    mylog << "GroupStatus : FGroup : Group " << groupId << " : not in battle" << std::endl;
-    CACHE_END(NULL);
+    RD_LOG(LOG_GROUP_STATUS) << "GroupStatus : FGroup : Group " << groupId << " : not in battle" << '\n';
+    return memo.store(memo_key(), NULL);
 }
 
 double EGroup::value_factor() const
 {
-    CACHE_BEGIN(double);
+    static Memo<double> memo("EGroup::value_factor");
+    if (const double *ret = memo.find(memo_key())) return *ret;
     double ret(0);
     for (const EUnit *e : member)
         ret += e->value_factor();
-    CACHE_END(inf_1(ret / 200));
+    return memo.store(memo_key(), inf_1(ret / 200));
 }
 
 double EGroup::mine_factor() const
 {
-    CACHE_BEGIN(double);
+    static Memo<double> memo("EGroup::mine_factor");
+    if (const double *ret = memo.find(memo_key())) return *ret;
     for (const EUnit *_u : member)
     {
+        if (_u->get_kind() != KIND_MINE) continue;
         const PUnit *p = _u->get_entity();
-        if (lowerCase(p->name) != "mine") continue;
         if (console->unitArg("energy", "c", p) > ENEMY_MINE_ENERGY_THRESHOLD )
-            { CACHE_END(1.0); } // use {} to protect macro
-        UnitFilter filter;
-        filter.setAvoidFilter("mine", "a");
-        filter.setAvoidFilter("observer", "a");
-        filter.setAreaFilter(new Circle(p->pos, MINING_RANGE * 4));
+            return memo.store(memo_key(), 1.0);
+        UnitQuery query;
+        query.avoid(KIND_MINE).avoid(KIND_OBSERVER);
         if (
             console->unitArg("energy", "c", p) > 0 &&
-            (/*console->enemyUnits(filter).empty() || */! console->friendlyUnits(filter).empty())
-           ) { CACHE_END(1.0); } // use {} to protect macro
+            (/*! conductor.get_index().any(p->pos, MINING_RANGE * 4, query.enemy()) || */conductor.get_index().any(p->pos, MINING_RANGE * 4, query.friendly()))
+           ) return memo.store(memo_key(), 1.0);
     }
-    CACHE_END(0.0);
+    return memo.store(memo_key(), 0.0);
 }
 
 void FGroup::releaseMine()
@@ -1468,21 +2560,31 @@ void FGroup::releaseMine()
 
 bool FGroup::checkGoback()
 {
+    RD_PROFILE_SCOPE("FGroup::checkGoback");
     if (
         health_factor() >= GOBACK_HEALTH_THRESHOLD &&
         surround_factor() >= GOBACK_SURROUND_THRESHOLD
        ) return false;
-    mylog << "GroupStatus : Group " << groupId << " : surround_factor = " << surround_factor() << std::endl;
-    console->changeShortestPathFunc(findSafePath);
+    RD_LOG(LOG_GROUP_STATUS) << "GroupStatus : Group " << groupId << " : surround_factor = " << surround_factor() << '\n';
+    // the thresholds do not see who is winning the fight at hand
+    if (! conductor.out_of_time())
+    {
+        const double stay(std::max(combat_outcome(COMBAT_FIGHT).score(), combat_outcome(COMBAT_HOLD).score())),
+                     run(combat_outcome(COMBAT_RETREAT).score());
+        RD_LOG(LOG_GROUP_STATUS) << "GroupStatus : Group " << groupId << " : rollout stay " << stay << ", retreat " << run << '\n';
+        if (stay > run + COMBAT_STAY_MARGIN) return false;
+    }
+    conductor.use_safe_path(true);
     for (FUnit *u : member)
         u->move(MILITARY_BASE_POS[console->camp()]);
-    console->changeShortestPathFunc(findShortestPath);
-    mylog << "GroupAction : Group " << groupId << " : go back " << std::endl;
+    conductor.use_safe_path(false);
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : go back " << '\n';
     return true;
 }
 
 bool FGroup::checkAttackBase()
 {
+    RD_PROFILE_SCOPE("FGroup::checkAttackBase");
     if (
         ! conductor.alarmed() &&
         (
@@ -1501,24 +2603,16 @@ bool FGroup::checkAttackBase()
     attackBase = true;
     const EGroup *target(0);
     double cur(0);
+    UnitQuery query;
+    query.enemy().avoid(KIND_MINE).avoid(KIND_OBSERVER).kinds(~MONSTER_KINDS).alive().not_reviving();
     for (const FUnit *u : member)
-    {
-        UnitFilter filter;
-        filter.setAreaFilter(new Circle(u->get_entity()->pos, u->get_entity()->view), "a");
-        filter.setAvoidFilter("mine", "a");
-        filter.setAvoidFilter("observer", "a");
-        filter.setAvoidFilter("roshan", "a");
-        filter.setAvoidFilter("dragon", "a");
-        filter.setHpFilter(1, 0x7fffffff);
-        for (const PUnit *e : console->enemyUnits(filter))
+        conductor.get_index().for_each(u->get_entity()->pos, u->get_entity()->view, query, [&](const PUnit *e)
         {
-            if (console->getBuff("reviving", e)) continue;
             double _cur = conductor.get_e_unit(e->id)->get_belongs()->value_factor();
             if (! target || _cur > cur)
                 target = conductor.get_e_unit(e->id)->get_belongs(), cur = _cur;
-        }
-    }
-    mylog << "GroupAction : Group " << groupId << " : attack base" << std::endl;
+        });
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : attack base" << '\n';
     if (! target)
         for (FUnit *u : member)
             u->move(MILITARY_BASE_POS[1 - console->camp()]);
@@ -1530,26 +2624,25 @@ bool FGroup::checkAttackBase()
 
 bool FGroup::checkProtectBase()
 {
+    RD_PROFILE_SCOPE("FGroup::checkProtectBase");
     if (! conductor.alarmed()) return false;
-    UnitFilter filter;
-    filter.setAreaFilter(new Circle(MILITARY_BASE_POS[console->camp()], MILITARY_BASE_RANGE), "a");
-    filter.setHpFilter(1, 0x7fffffff);
-    auto enemy = console->enemyUnits(filter);
-    if (enemy.empty())
+    const PUnit *enemy = conductor.get_index().first(MILITARY_BASE_POS[console->camp()], MILITARY_BASE_RANGE, UnitQuery().enemy().alive());
+    if (! enemy)
         for (FUnit *u : member)
             u->move(MILITARY_BASE_POS[console->camp()]);
     else
         for (FUnit *u : member)
-            u->attack(*(conductor.get_e_unit(enemy.front()->id)->get_belongs()));
-    mylog << "GroupAction : Group " << groupId << " : protect base " << std::endl;
+            u->attack(*(conductor.get_e_unit(enemy->id)->get_belongs()));
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : protect base " << '\n';
     return true;
 }
 
 bool FGroup::checkScout()
 {
+    RD_PROFILE_SCOPE("FGroup::checkScout");
     if (member.size() > 1) return false;
     const FUnit *u = member.front();
-    if (! (lowerCase(u->get_entity()->name) == "scouter" &&
+    if (! (u->get_kind() == KIND_SCOUTER &&
            u->get_entity()->mp >= SET_OBSERVER_MP &&
            u->get_entity()->findSkill("setobserver")->cd == 0
           ))
@@ -1568,20 +2661,13 @@ bool FGroup::checkScout()
     Pos oldScoutPos = curScoutPos;
     if (curScoutPos != Pos(-1, -1))
     {
-        UnitFilter filter;
-        filter.setAreaFilter(new Circle(curScoutPos, MINING_RANGE*4), "a");
-        filter.setHpFilter(1, 0x7fffffff);
-        filter.setAvoidFilter("observer", "a");
-        filter.setAvoidFilter("mine", "a");
-        if (! console->enemyUnits(filter).empty() && dis2(curScoutPos, center()) < 64)
+        const UnitIndex &index = conductor.get_index();
+        UnitQuery query;
+        query.enemy().alive().avoid(KIND_OBSERVER).avoid(KIND_MINE);
+        if (index.any(curScoutPos, MINING_RANGE*4, query) && dis2(curScoutPos, center()) < 64)
+            curScoutPos = Pos(-1, -1);
+        else if (index.any(curScoutPos, MINING_RANGE*4, query.kinds(MONSTER_KINDS)) && dis2(curScoutPos, center()) < SCOUTER_VIEW)
             curScoutPos = Pos(-1, -1);
-        else
-        {
-            filter.setTypeFilter("roshan", "a");
-            filter.setTypeFilter("dragon", "a");
-            if (! console->enemyUnits(filter).empty() && dis2(curScoutPos, center()) < SCOUTER_VIEW)
-                curScoutPos = Pos(-1, -1);
-        }
     }
     if (curScoutPos == Pos(-1, -1))
     {
@@ -1590,16 +2676,10 @@ bool FGroup::checkScout()
         {
             const Pos &p = MINE_POS[i];
             if (p == oldScoutPos) continue;
-            int enemyCnt = 0;
-            for (const auto &x : conductor.get_enemy_pos())
-                if (dis2(conductor.get_p_unit(x.first)->pos, p) <= MINING_RANGE * 16)
-                    enemyCnt ++;
-            mylog << "GroupAction : FGroup " << groupId << " : mine " << p << " : enemyCnt = " << enemyCnt << std::endl;
+            int enemyCnt = conductor.count_enemy_tracks(p, MINING_RANGE * 16);
+            RD_LOG(LOG_GROUP_ACTION) << "GroupAction : FGroup " << groupId << " : mine " << p << " : enemyCnt = " << enemyCnt << '\n';
             if (enemyCnt < 1 && enemyCnt > 3) continue;
-            UnitFilter filter;
-            filter.setAreaFilter(new Circle(p, MINING_RANGE*4), "a");
-            filter.setHpFilter(1, 0x7fffffff);
-            if (! console->friendlyUnits(filter).empty()) continue;
+            if (conductor.get_index().any(p, MINING_RANGE*4, UnitQuery().friendly().alive())) continue;
             candidate.push_back(p);
         }
         if (candidate.empty())
@@ -1614,7 +2694,16 @@ bool FGroup::checkScout()
         curScoutPos = candidate[conductor.random(0, candidate.size() - 1)];
     }
     member.front()->move(curScoutPos);
-    mylog << "GroupAction : Group " << groupId << " : scout " << curScoutPos << std::endl;
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : scout " << curScoutPos << '\n';
+    return true;
+}
+
+bool FGroup::checkPlanned()
+{
+    if (plannedEpoch != memoEpoch || ! plannedTarget) return false;
+    for (FUnit *u : member)
+        u->attack(*plannedTarget);
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : planned attack on Group " << plannedTarget->groupId << '\n';
     return true;
 }
 
@@ -1626,7 +2715,8 @@ bool FGroup::checkAttack()
 }
 
 bool FGroup::checkMine()
-{   
+{
+    RD_PROFILE_SCOPE("FGroup::checkMine");   
     if (member.size() < CUR_MINE_MEMBER_THRESHOLD)
     {
         releaseMine();
@@ -1639,96 +2729,36 @@ bool FGroup::checkMine()
         double new_factor = g.mine_factor() / g.danger_factor();
         new_factor = inf_1(new_factor / inf_1(dis2(center(), g.center()) * MINE_DIS_FACTOR));
         if (std::isnan(new_factor)) new_factor = 0;
-        mylog << "GroupAction : FGroup " << groupId << " : check mine. new_factor = " << new_factor << std::endl;
+        RD_LOG(LOG_GROUP_ACTION) << "GroupAction : FGroup " << groupId << " : check mine. new_factor = " << new_factor << '\n';
         if (new_factor <= MINE_THRESHOLD * 0.8) // use <= because of 0
             releaseMine();
     }
     
-    Pos nextMinePos(-1, -1);
-    if (member.size() >= NEW_MINE_MEMBER_THRESHOLD)
+    // chosen for all the groups at once by Conductor::assign_mines
+    Pos next(nextMinePos);
+    if (next != MINE_POS[0] && next != Pos(-1, -1))
     {
-        double cur_factor = 0.0;
-        for (const EGroup &g : conductor.get_e_groups())
-        {
-            double new_factor = g.mine_factor() / g.danger_factor();
-            new_factor = inf_1(new_factor / inf_1(dis2(center(), g.center()) * MINE_DIS_FACTOR));
-            if (std::isnan(new_factor)) new_factor = 0;
-            Pos _minePos;
-            for (const EUnit *u : g.get_member())
-                if (lowerCase(u->get_entity()->name) == "mine")
-                {
-                    _minePos = u->get_entity()->pos;
-                    break;
-                }
-            if (! conductor.is_mining(_minePos) && new_factor > MINE_THRESHOLD && new_factor > cur_factor)
-                cur_factor = new_factor, nextMinePos = _minePos;
-        }
-        if (nextMinePos == Pos(-1, -1))
-        {
-            for (int i=0; i<MINE_NUM; i++)
-            {
-                const Pos &p = MINE_POS[i];
-                if (
-                    ! conductor.mine_visible(p) &&
-                    ! conductor.is_mining(p) &&
-                    conductor.get_energy(p) >= ENEMY_MINE_ENERGY_THRESHOLD &&
-                    (nextMinePos == Pos(-1, -1) || dis2(center(), MINE_POS[i]) < dis2(center(), nextMinePos))
-                   )
-                {
-                    int enemyCnt = 0;
-                    for (const auto &x : conductor.get_enemy_pos())
-                        if (dis2(conductor.get_p_unit(x.first)->pos, p) <= MINING_RANGE * 16)
-                            enemyCnt ++;
-                    mylog << "GroupAction : FGroup " << groupId << " : mine " << p << " : enemyCnt = " << enemyCnt << std::endl;
-                    if (enemyCnt <= member.size()*1.25)
-                        nextMinePos = p;
-                }
-            }
-        }
-        if (nextMinePos == Pos(-1, -1) && curMinePos == Pos(-1, -1))
-        {
-            for (int i=0; i<MINE_NUM; i++)
-            {
-                const Pos &p = MINE_POS[i];
-                if (
-                    ! conductor.mine_visible(p) &&
-                    ! conductor.is_mining(p) &&
-                    conductor.get_energy(p) > 0 && // the difference
-                    (nextMinePos == Pos(-1, -1) || dis2(center(), MINE_POS[i]) < dis2(center(), nextMinePos))
-                   )
-                {
-                    int enemyCnt = 0;
-                    for (const auto &x : conductor.get_enemy_pos())
-                        if (dis2(conductor.get_p_unit(x.first)->pos, p) <= MINING_RANGE * 16)
-                            enemyCnt ++;
-                    mylog << "GroupAction : FGroup " << groupId << " : mine " << p << " : enemyCnt = " << enemyCnt << std::endl;
-                    if (enemyCnt <= member.size()*1.25)
-                        nextMinePos = p;
-                }
-            }
-        }
-        if (nextMinePos != MINE_POS[0] && nextMinePos != Pos(-1, -1))
-        {
-            Pos v1(center() - MINE_POS[0]), v2(nextMinePos - MINE_POS[0]);
-            if (dis2(v1, Pos(0,0)) > 4 * MINING_RANGE && (v1.x * v2.x + v1.y * v2.y) / (dis(v1,Pos(0,0)) * dis(v2,Pos(0,0))) < cos(0.66 * pi))
-                nextMinePos = MINE_POS[0];
-        }
+        Pos v1(center() - MINE_POS[0]), v2(next - MINE_POS[0]);
+        if (dis2(v1, Pos(0,0)) > 4 * MINING_RANGE && (v1.x * v2.x + v1.y * v2.y) / (dis(v1,Pos(0,0)) * dis(v2,Pos(0,0))) < cos(0.66 * pi))
+            next = MINE_POS[0];
     }
     
-    if (curMinePos == Pos(-1, -1) || ! in_battle() && nextMinePos != Pos(-1, -1) && dis2(center(), nextMinePos) < dis2(center(), curMinePos))
-        releaseMine(), curMinePos = nextMinePos;
+    // no distance check against the current mine as before : the assignment may have given it to another group.
+    // MINE_KEEP_BONUS in mine_score is what keeps a group from swapping back and forth
+    if (curMinePos == Pos(-1, -1) || (! in_battle() && next != Pos(-1, -1) && next != curMinePos))
+        releaseMine(), curMinePos = next;
     
     const EGroup *curTarget = conductor.mine_visible(curMinePos);
     if (curTarget)
     {
         for (FUnit *u : member)
             u->mine(*curTarget);
-        mylog << "GroupAction : Group " << groupId << " : mine Group " << curTarget->groupId << std::endl;
+        RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : mine Group " << curTarget->groupId << '\n';
     } else if (curMinePos != Pos(-1, -1))
     {
         for (FUnit *u : member)
             u->move(curMinePos);
-        mylog << "GroupAction : Group " << groupId << " : mine Pos " << curMinePos << std::endl;
+        RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : mine Pos " << curMinePos << '\n';
     } else
         return false;
     
@@ -1736,9 +2766,122 @@ bool FGroup::checkMine()
     return true;
 }
 
+const EUnit *FGroup::focus_target(const FUnit *u, const EGroup &target) const
+{
+    if (focusEpoch != memoEpoch || focusGroup != target.groupId)
+        plan_focus(target);
+    for (const auto &x : focus)
+        if (x.first == u->get_id())
+            return x.second;
+    return 0;
+}
+
+void FGroup::plan_focus(const EGroup &target) const
+{
+    RD_PROFILE_SCOPE("FGroup::plan_focus");
+    focusEpoch = memoEpoch, focusGroup = target.groupId;
+    focus.clear();
+    const UnitTable &table = conductor.get_table();
+
+    std::vector<std::pair<double, const EUnit*> > enemies; // most valuable first
+    for (const EUnit *e : target.get_member())
+    {
+        if (e->get_kind() == KIND_OBSERVER || e->get_kind() == KIND_MINE) continue;
+        if (target.has_player() && (kind_bit(e->get_kind()) & MONSTER_KINDS)) continue;
+        enemies.push_back(std::make_pair(e->value_factor(), e));
+    }
+    std::stable_sort(enemies.begin(), enemies.end(),
+        [](const std::pair<double, const EUnit*> &a, const std::pair<double, const EUnit*> &b) { return a.first > b.first; });
+    const int n(member.size()), m(enemies.size());
+
+    // reach : within the range Character::attack allows, of where the enemy is or is going.
+    // damage : per round, one hit every attack cooldown
+    std::vector<bool> reach(n * m), assigned(n);
+    std::vector<double> damage(n * m);
+    for (int i=0; i<n; i++)
+    {
+        const PUnit *a = member[i]->get_entity();
+        const PSkill *attack = a->findSkill("attack");
+        const int cd(attack->cd), maxRange(sqr(sqrt(a->range) + cd * sqrt(a->speed)));
+        const double atk(table.atk[conductor.table_row(a->id)]);
+        for (int j=0; j<m; j++)
+        {
+            const EUnit *e = enemies[j].second;
+            reach[i * m + j] = dis2(a->pos, e->get_entity()->pos) <= maxRange || dis2(a->pos, e->predict_pos()) <= maxRange;
+            damage[i * m + j] = std::max(1.0, atk - table.def[conductor.table_row(e->get_id())] * FOCUS_DEF_RATE) / std::max(attack->maxCd, 1);
+        }
+    }
+
+    // secure the kills, most valuable first, each with the fewest and hardest hitters. hp is per round of FOCUS_ROUND
+    std::vector<int> hitters;
+    for (int j=0; j<m; j++)
+    {
+        const double hp(table.hp[conductor.table_row(enemies[j].second->get_id())] / FOCUS_ROUND);
+        if (hp <= 0) continue;
+        hitters.clear();
+        for (int i=0; i<n; i++)
+            if (! assigned[i] && reach[i * m + j])
+                hitters.push_back(i);
+        std::stable_sort(hitters.begin(), hitters.end(), [&](int a, int b) { return damage[a * m + j] > damage[b * m + j]; });
+        double sum(0);
+        size_t k(0);
+        while (k < hitters.size() && sum < hp)
+            sum += damage[hitters[k++] * m + j];
+        if (sum < hp) continue;
+        for (size_t t=0; t<k; t++)
+        {
+            assigned[hitters[t]] = true;
+            focus.push_back(std::make_pair(member[hitters[t]]->get_id(), enemies[j].second));
+        }
+        RD_LOG(LOG_GROUP_ACTION) << "GroupAction : FGroup " << groupId << " : focus " << k << " on unit " << enemies[j].second->get_id() << '\n';
+    }
+
+    // the rest, as each would pick alone : the most valuable in reach
+    for (int i=0; i<n; i++)
+        if (! assigned[i])
+            for (int j=0; j<m; j++)
+                if (reach[i * m + j])
+                {
+                    focus.push_back(std::make_pair(member[i]->get_id(), enemies[j].second));
+                    break;
+                }
+}
+
+double FGroup::mine_score(int mine) const
+{
+    // visible mines worth the fight first, then unseen ones with enough energy left on arrival, then any energy.
+    // the nearer the better within each
+    const MineState &m = conductor.get_mines()[mine];
+    double ret;
+    if (m.visible)
+    {
+        double factor = m.visible->mine_factor() / m.visible->danger_factor();
+        factor = inf_1(factor / inf_1(dis2(center(), m.visible->center()) * MINE_DIS_FACTOR));
+        if (std::isnan(factor) || factor <= MINE_THRESHOLD) return 0;
+        ret = 2 + factor;
+    } else
+    {
+        if (conductor.count_enemy_tracks(m.pos, MINING_RANGE * 16) > member.size()*1.25) return 0;
+        int speed(0x7fffffff);
+        for (const FUnit *u : member)
+            speed = std::min(speed, u->get_entity()->speed);
+        const double d(dis(center(), m.pos)), energy(m.energy_after(d / sqrt(std::max(speed, 1))));
+        const double near(1 / (1 + d * MINE_DIS_FACTOR));
+        if (energy >= ENEMY_MINE_ENERGY_THRESHOLD)
+            ret = 1 + near;
+        else if (energy > 0 && (curMinePos == Pos(-1, -1) || curMinePos == m.pos))
+            ret = near;
+        else
+            return 0;
+    }
+    if (m.pos == curMinePos) ret += MINE_KEEP_BONUS;
+    return ret;
+}
+
 bool FGroup::checkJoin()
 {
-    mylog << "GroupStatus : FGroup : Group " << groupId << " : health_factor() = " << health_factor() << std::endl;
+    RD_PROFILE_SCOPE("FGroup::checkJoin");
+    RD_LOG(LOG_GROUP_STATUS) << "GroupStatus : FGroup : Group " << groupId << " : health_factor() = " << health_factor() << '\n';
     if (foundRound == console->round()) return false;
     if (curScoutPos != Pos(-1, -1)) return false;
     if (member.empty() || health_factor() < GOBACK_HEALTH_THRESHOLD) return false;
@@ -1751,45 +2894,45 @@ bool FGroup::checkJoin()
             (curMinePos == Pos(-1, -1) || curMinePos == g.curMinePos) &&
             (! attackBase || g.attackBase) &&
             //(g.health_factor() >= GOBACK_HEALTH_THRESHOLD || ! attackBase && curMinePos == Pos(-1, -1) && curScoutPos == Pos(-1, -1)) &&
-            //conductor.map_danger_factor(g.center()) > conductor.map_danger_factor(center()) &&
             dis2(g.center(), center()) <= JOIN_DIS2_THRESHOLD
            )
         {
-            mylog << "MapStatus : map_danger_factor at " << g.center() << " (g.center) is " << conductor.map_danger_factor(g.center()) << std::endl;
-            mylog << "MapStatus : map_danger_factor at " << center() << " (this->center) is " << conductor.map_danger_factor(center()) << std::endl;
+            RD_LOG(LOG_MAP_STATUS) << "MapStatus : enemy pressure at " << g.center() << " (g.center) is " << conductor.pressure(INFLUENCE_ENEMY, g.center()) << '\n';
+            RD_LOG(LOG_MAP_STATUS) << "MapStatus : enemy pressure at " << center() << " (this->center) is " << conductor.pressure(INFLUENCE_ENEMY, center()) << '\n';
             target = &g;
             break;
         }
     if (! target) return false;
     for (FUnit *u : member)
         target->add_member(u);
-    member.clear(), idSet.clear();
+    member.clear(), idSet.clear(), kindMask = 0;
     if (curMinePos != Pos(-1, -1) && target->curMinePos == Pos(-1, -1))
         conductor.reg_mining(curMinePos, target->groupId);
-    mylog << "GroupAction : Group " << groupId << " : join Group " << target->groupId << std::endl;
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : join Group " << target->groupId << '\n';
     return true;
 }
 
 bool FGroup::checkSplit()
 {
+    RD_PROFILE_SCOPE("FGroup::checkSplit");
     if (member.size() < 2 || health_factor() < GOBACK_HEALTH_THRESHOLD) return false;
     FGroup newGroup;
     std::vector<FUnit*> _member;
     while (! member.empty())
     {
-        mylog << "UnitStatus : Unit " << member.back()->id
+        RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : Unit " << member.back()->id
               << " : health_factor() = " << member.back()->health_factor()
-              << " , hp = " << member.back()->get_entity()->hp << std::endl;
+              << " , hp = " << member.back()->get_entity()->hp << '\n';
         if (
             // wounded goes back
-            member.back()->health_factor() < GOBACK_HEALTH_THRESHOLD &&
-            ! console->getBuff("winordie", member.back()->get_entity()) &&
-            ! console->getBuff("dizzy", member.back()->get_entity())
+            (member.back()->health_factor() < GOBACK_HEALTH_THRESHOLD &&
+             ! conductor.has_buff(member.back()->get_entity(), BUFF_WINORDIE) &&
+             ! conductor.has_buff(member.back()->get_entity(), BUFF_DIZZY))
             || // deleted the died
-            console->getBuff("reviving", member.back()->get_entity())
+            conductor.has_buff(member.back()->get_entity(), BUFF_REVIVING)
             || // split out scouter
             ! in_battle() && ! attackBase && curMinePos == Pos(-1, -1) &&
-            lowerCase(member.back()->get_entity()->name) == "scouter" &&
+            member.back()->get_kind() == KIND_SCOUTER &&
             member.back()->get_entity()->mp >= SET_OBSERVER_MP &&
             member.back()->get_entity()->findSkill("setobserver")->cd == 0
            )
@@ -1802,36 +2945,55 @@ bool FGroup::checkSplit()
         member.pop_back();
     }
     member = std::move(_member);
+    update_kind_mask();
     if (member.empty())
     {
         *this = std::move(newGroup);
         return false;
     }
     if (newGroup.member.empty()) return false;
-    mylog << "GroupAction : Group " << groupId << " : split " << std::endl;
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : split " << '\n';
     const_cast<std::vector<FGroup>&>(conductor.get_f_groups()).push_back(std::move(newGroup)); // keep this the last line
     return true;
 }
 
 bool FGroup::checkSupport()
 {
+    RD_PROFILE_SCOPE("FGroup::checkSupport");
     if (health_factor() < GOBACK_HEALTH_THRESHOLD) return false;
     const FGroup *target = 0;
-    double cur(INFINITY);
+    double cur(INFINITY), gain(-INFINITY);
+    CombatState self, joined; // self is taken at the first candidate
+    self.n = 0;
+    // groups under more enemy pressure, net of their friends', than we are
+    auto net = [](const Pos &p) { return conductor.pressure(INFLUENCE_ENEMY, p) - conductor.pressure(INFLUENCE_FRIEND, p); };
     for (const FGroup &g : conductor.get_f_groups())
         if (
             g.groupId != groupId &&
-            conductor.map_danger_factor(g.center()) > conductor.map_danger_factor(center())
+            net(g.center()) > net(center())
            )
         {
-            mylog << "MapStatus : map_danger_factor at " << g.center() << " (g.center) is " << conductor.map_danger_factor(g.center()) << std::endl;
-            mylog << "MapStatus : map_danger_factor at " << center() << " (this->center) is " << conductor.map_danger_factor(center()) << std::endl;
+            RD_LOG(LOG_MAP_STATUS) << "MapStatus : net pressure at " << g.center() << " (g.center) is " << net(g.center()) << '\n';
+            RD_LOG(LOG_MAP_STATUS) << "MapStatus : net pressure at " << center() << " (this->center) is " << net(center()) << '\n';
             double _cur = g.surround_factor();
-            if (_cur < SUPPORT_SURROUND_THRESHOLD && (_cur < cur || ! target))
-                target = &g, cur = _cur;
+            if (_cur >= SUPPORT_SURROUND_THRESHOLD) continue;
+            // the group our joining helps most, by the rollout of its fight with us added. else the most surrounded
+            double _gain(0);
+            if (! conductor.out_of_time())
+            {
+                if (! self.n) combat_snapshot(self);
+                g.combat_snapshot(joined);
+                for (int i=0; i<self.n; i++)
+                    if (! self.unit[i].enemy)
+                        if (CombatUnit *c = joined.add())
+                            *c = self.unit[i];
+                _gain = combat_rollout(joined, COMBAT_FIGHT).score() - g.combat_outcome(COMBAT_FIGHT).score();
+            }
+            if (! target || _gain > gain || (_gain == gain && _cur < cur))
+                target = &g, cur = _cur, gain = _gain;
         }
     if (! target) return false;
-    mylog << "GroupAction : Group " << groupId << " : support Group " << target->groupId << std::endl;
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : support Group " << target->groupId << '\n';
     Pos targetPos = target->center();
     const EGroup *targetEnemy = target->in_battle();
     if (targetEnemy && dis2(center(), targetPos) < 225)
@@ -1840,41 +3002,75 @@ bool FGroup::checkSupport()
             u->attack(*targetEnemy);
     } else
     {
-        console->changeShortestPathFunc(findSafePath);
+        conductor.use_safe_path(true);
         for (FUnit *u : member)
             u->move(targetPos);
-        console->changeShortestPathFunc(findShortestPath);
+        conductor.use_safe_path(false);
     }
     return true;
 }
 
 bool FGroup::checkSearch()
 {
+    RD_PROFILE_SCOPE("FGroup::checkSearch");
     Circle outer(MILITARY_BASE_POS[console->camp()], SEARCH_RANGE2),
            inner(MILITARY_BASE_POS[console->camp()], MILITARY_BASE_VIEW * 1.2);
     for (FUnit *u : member)
     {
-        Pos p;
-        do
-            p = outer.randPosInArea();
-        while (inner.contain(p) || p.x <= 0 || p.y <= 0 || p.x >= MAP_SIZE || p.y >= MAP_SIZE);
-        u->move(p);
+        Pos p;
+        do
+            p = outer.randPosInArea();
+        while (inner.contain(p) || p.x <= 0 || p.y <= 0 || p.x >= MAP_SIZE || p.y >= MAP_SIZE);
+        u->move(p);
+    }
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : search " << '\n';
+    return true;
+}
+
+TraceBranch FGroup::decide()
+{
+    if (checkGoback()) { releaseMine(), releaseScout(); return BRANCH_GOBACK; }
+    if (checkAttackBase()) { releaseMine(), releaseScout(); return BRANCH_ATTACK_BASE; }
+    if (checkProtectBase()) { releaseMine(), releaseScout(); return BRANCH_PROTECT_BASE; }
+    if (checkPlanned()) { releaseMine(), releaseScout(); return BRANCH_PLANNED; }
+    if (checkScout()) { releaseMine(); return BRANCH_SCOUT; }
+    if (checkMine()) return BRANCH_MINE;
+    if (checkSupport()) return BRANCH_SUPPORT;
+    if (checkAttack()) return BRANCH_ATTACK;
+    if (checkSearch()) return BRANCH_SEARCH;
+    return BRANCH_NONE;
+}
+
+int FGroup::priority() const
+{
+    if (in_battle()) return 3;
+    if (conductor.alarmed() && dis2(center(), MILITARY_BASE_POS[console->camp()]) <= ALARM_RANGE2) return 2;
+    if (curMinePos != Pos(-1, -1)) return 1;
+    return 0;
+}
+
+void FGroup::fallback()
+{
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Group " << groupId << " : out of time, repeat last orders" << '\n';
+    for (FUnit *u : member)
+        u->repeat_order();
+    if (TRACE_ON)
+    {
+        Pos c = center();
+        tracer.put(TRACE_ACTION, TraceAction{ groupId, BRANCH_FALLBACK, c.x, c.y });
     }
-    mylog << "GroupAction : Group " << groupId << " : search " << std::endl;
-    return true;
 }
 
 void FGroup::action()
 {
+    RD_PROFILE_SCOPE("FGroup::action");
     logMsg();
-    if (checkGoback()) { releaseMine(), releaseScout(); return; }
-    if (checkAttackBase()) { releaseMine(), releaseScout(); return; }
-    if (checkProtectBase()) { releaseMine(), releaseScout(); return; }
-    if (checkScout()) { releaseMine(); return; }
-    if (checkMine()) return;
-    if (checkSupport()) return;
-    if (checkAttack()) return;
-    if (checkSearch()) return;
+    TraceBranch branch = decide();
+    if (TRACE_ON)
+    {
+        Pos c = center();
+        tracer.put(TRACE_ACTION, TraceAction{ groupId, branch, c.x, c.y });
+    }
 }
 
 /********************************/
@@ -1906,103 +3102,511 @@ double Conductor::need_buy_hero() const
     return (double)console->gold() / console->property();
 }
 
-double Conductor::map_danger_factor(const Pos &p) const
-{
-    double x(p.x), y(p.y), tot(0);
-    tot += 2.0 / pow(dis2(Pos(x,y), MILITARY_BASE_POS[1-console->camp()]), 0.1);
-    for (int i=0; i<MINE_NUM; i++)
-        tot += 0.7 / pow(dis2(Pos(x,y), MINE_POS[i]), 0.2);
-    return log(inf_1(pow(tot, 3.0) / 2)) * 4;
-}
-
 void Conductor::enemy_make_groups()
 {
-    eGroups.clear();
-    for (const PUnit *item : console->enemyUnits())
-        if (! console->getBuff("reviving", item) && ! get_e_unit(item->id)->get_belongs())
+    RD_PROFILE_SCOPE("Conductor::enemy_make_groups");
+    // union-find over enemies linked within ENEMY_JOIN_DIS2 (including mine)
+    // a link needs both ends alive. links between units that did not move are kept from last round,
+    // only the moved ones query the index again
+    std::vector<const PUnit*> nodes;
+    index.for_each(UnitQuery().enemy().not_reviving(), [&](const PUnit *u) { nodes.push_back(u); });
+    const int n = nodes.size();
+
+    for (const PUnit *u : nodes)
+        if (u->id >= (int)clusterNodes.size())
+            clusterNodes.resize(u->id + 1);
+    std::vector<int> nodeOf(clusterNodes.size(), -1);
+    for (int i=0; i<n; i++)
+        nodeOf[nodes[i]->id] = i;
+
+    const int lastStamp = clusterStamp++;
+    std::vector<bool> moved(n);
+    for (int i=0; i<n; i++)
+    {
+        const ClusterNode &c = clusterNodes[nodes[i]->id];
+        moved[i] = c.stamp != lastStamp || c.pos != nodes[i]->pos || c.alive != (nodes[i]->hp >= 1);
+    }
+    for (int i=0; i<n; i++)
+    {
+        std::vector<int> &adj = clusterNodes[nodes[i]->id].adj;
+        if (moved[i])
+            adj.clear();
+        else
+            adj.erase(std::remove_if(adj.begin(), adj.end(), [&](int id)
+            {
+                return id >= (int)nodeOf.size() || ! ~nodeOf[id] || moved[nodeOf[id]];
+            }), adj.end());
+    }
+    for (int i=0; i<n; i++)
+    {
+        if (! moved[i] || nodes[i]->hp < 1) continue;
+        index.for_each(nodes[i]->pos, ENEMY_JOIN_DIS2, UnitQuery().enemy().alive().not_reviving(), [&](const PUnit *u)
         {
-            eGroups.push_back(EGroup());
-            eGroups.back().add_adj_members_recur(get_e_unit(item->id));
-            eGroups.back().logMsg();
+            int j = nodeOf[u->id];
+            if (j == i) return;
+            clusterNodes[nodes[i]->id].adj.push_back(u->id);
+            if (! moved[j])
+                clusterNodes[u->id].adj.push_back(nodes[i]->id);
+        });
+    }
+    for (int i=0; i<n; i++)
+    {
+        ClusterNode &c = clusterNodes[nodes[i]->id];
+        c.stamp = clusterStamp, c.pos = nodes[i]->pos, c.alive = nodes[i]->hp >= 1;
+    }
+
+    // root is always the smallest index, so components come out in info->units order
+    std::vector<int> parent(n);
+    for (int i=0; i<n; i++)
+        parent[i] = i;
+    auto find = [&](int x)
+    {
+        while (parent[x] != x)
+            x = parent[x] = parent[parent[x]];
+        return x;
+    };
+    for (int i=0; i<n; i++)
+        for (int id : clusterNodes[nodes[i]->id].adj)
+        {
+            int a(find(i)), b(find(nodeOf[id]));
+            if (a != b)
+                parent[std::max(a, b)] = std::min(a, b);
         }
+    int compCnt(0);
+    std::vector<int> compOf(n), rootComp(n, -1);
+    for (int i=0; i<n; i++)
+    {
+        int r = find(i);
+        if (! ~rootComp[r])
+            rootComp[r] = compCnt++;
+        compOf[i] = rootComp[r];
+    }
+
+    // each component inherits the old group sharing the most members with it, to keep groupId
+    std::vector<EGroup> old;
+    old.swap(eGroups); // elements stay in place, so `belongs` is still valid
+    std::map<std::pair<int, int>, int> overlap; // (component, old group) -> members in common
+    for (int i=0; i<n; i++)
+    {
+        const EGroup *g = get_e_unit(nodes[i]->id)->get_belongs();
+        if (g)
+            overlap[std::make_pair(compOf[i], int(g - old.data()))]++;
+    }
+    std::vector<std::pair<int, std::pair<int, int> > > candidate;
+    for (const auto &x : overlap)
+        candidate.push_back(std::make_pair(-x.second, x.first));
+    std::sort(candidate.begin(), candidate.end());
+    std::vector<int> compOld(compCnt, -1);
+    std::vector<bool> taken(old.size());
+    for (const auto &x : candidate)
+    {
+        int comp(x.second.first), k(x.second.second);
+        if (! ~compOld[comp] && ! taken[k])
+            compOld[comp] = k, taken[k] = true;
+    }
+
+    for (EGroup &g : old)
+        g.clear_member();
+    eGroups.reserve(compCnt);
+    for (int c=0; c<compCnt; c++)
+        if (~compOld[c])
+            eGroups.push_back(std::move(old[compOld[c]]));
+        else
+            eGroups.push_back(EGroup());
+    for (int i=0; i<n; i++)
+        eGroups[compOf[i]].add_member(get_e_unit(nodes[i]->id));
+    for (const EGroup &g : eGroups)
+        g.logMsg();
 }
 
 void Conductor::log_mining() const
 {
+    if (! log_on(LOG_MINE_STATUS)) return;
     mylog << "MineStatus : { ";
-    for (auto i=mining.begin(); i!=mining.end(); i++)
-        mylog << i->first << " -> " << i->second << ", ";
-    mylog << "}" << std::endl;
+    for (const MineState &m : mines)
+        if (~m.claimedBy)
+            mylog << m.pos << " -> " << m.claimedBy << ", ";
+    mylog << "}" << '\n';
+}
+
+void Conductor::log_memo_stats() const
+{
+    for (const MemoStat *m = MemoStat::head; m; m = m->next)
+        RD_LOG(LOG_MEMO_STATUS) << "MemoStatus : " << m->name << " : hit = " << m->hit << " , miss = " << m->miss << '\n';
+}
+
+void Conductor::trace_round() const
+{
+    if (! TRACE_ON) return;
+    tracer.put(TRACE_ROUND, TraceRound{ console->round(), console->camp(), console->gold() });
+    for (const UnitIndex::Entry &e : index.get_entries())
+    {
+        const PUnit *u = e.unit;
+        tracer.put(TRACE_UNIT, TraceUnit{ u->id, u->camp, e.kind, u->level, u->hp, u->mp, e.pos.x, e.pos.y });
+    }
+}
+
+void Conductor::trace_groups() const
+{
+    if (! TRACE_ON) return;
+    std::vector<int32_t> ids;
+    for (const EGroup &g : eGroups)
+    {
+        ids.clear();
+        for (const EUnit *u : g.get_member()) ids.push_back(u->get_id());
+        tracer.put(TRACE_E_GROUP, TraceEGroup{ g.groupId, (int32_t) g.kind_mask(), (int32_t) ids.size(),
+            (float) g.danger_factor(), (float) g.value_factor(), (float) g.mine_factor() }, ids);
+    }
+    for (const FGroup &g : fGroups)
+    {
+        ids.clear();
+        for (const FUnit *u : g.get_member()) ids.push_back(u->get_id());
+        tracer.put(TRACE_F_GROUP, TraceFGroup{ g.groupId, (int32_t) g.kind_mask(), (int32_t) ids.size(),
+            (float) g.ability_factor(), (float) g.health_factor(), (float) g.surround_factor() }, ids);
+    }
 }
 
 void Conductor::reg_mining(const Pos &p, int id)
 {
-    mylog << "MineStatus : Position " << p << " required by FGroup " << id << std::endl;
-    mining[p] = id;
+    RD_LOG(LOG_MINE_STATUS) << "MineStatus : Position " << p << " required by FGroup " << id << '\n';
+    assert(~mine_id(p));
+    mines[mine_id(p)].claimedBy = id;
     log_mining();
 }
 
 void Conductor::del_mining(const Pos &p)
 {
-    mylog << "MineStatus : Position " << p << " dropped " << std::endl;
-    mining.erase(p);
+    RD_LOG(LOG_MINE_STATUS) << "MineStatus : Position " << p << " dropped " << '\n';
+    if (~mine_id(p))
+        mines[mine_id(p)].claimedBy = -1;
     log_mining();
 }
 
+void Conductor::assign_mines()
+{
+    RD_PROFILE_SCOPE("Conductor::assign_mines");
+    // groups too small for a new mine, or fighting at theirs, keep what they have. the rest share the other
+    // mines by mine_score, with a column per group for going without. cost of a pair not wanted is far above any score
+    const double UNWANTED = 1e9;
+    std::vector<FGroup*> rows;
+    std::vector<bool> held(MINE_NUM, false);
+    for (FGroup &g : fGroups)
+    {
+        g.set_next_mine(Pos(-1, -1));
+        const int cur(mine_id(g.get_cur_mine()));
+        if (g.get_member().size() < NEW_MINE_MEMBER_THRESHOLD || (~cur && g.in_battle()))
+        {
+            if (~cur) held[cur] = true;
+        } else
+            rows.push_back(&g);
+    }
+    if (rows.empty()) return;
+
+    std::vector<std::vector<double> > cost(rows.size(), std::vector<double>(MINE_NUM + rows.size(), 0));
+    for (size_t i=0; i<rows.size(); i++)
+        for (int j=0; j<MINE_NUM; j++)
+        {
+            const double score(held[j] ? 0 : rows[i]->mine_score(j));
+            cost[i][j] = score > 0 ? -score : UNWANTED;
+        }
+    const std::vector<int> col(min_cost_assignment(cost));
+    for (size_t i=0; i<rows.size(); i++)
+        if (col[i] < MINE_NUM && cost[i][col[i]] < 0)
+        {
+            rows[i]->set_next_mine(MINE_POS[col[i]]);
+            RD_LOG(LOG_MINE_STATUS) << "MineStatus : Position " << MINE_POS[col[i]] << " assigned to FGroup " << rows[i]->groupId << '\n';
+        }
+}
+
+void Conductor::plan_groups(const std::vector<FGroup*> &order)
+{
+    RD_PROFILE_SCOPE("Conductor::plan_groups");
+    // beam search over the groups in order, each either attacking an enemy group near it or left to the cascade.
+    // an attack is worth its rollout with every group planned on the same target, less PLAN_ATTACK_MARGIN,
+    // and the cascade nothing. groups not reached by PLAN_BUDGET are left to the cascade
+    const int n(order.size());
+    if (n > 64) return; // the attackers of a target are kept as a bit mask
+
+    std::vector<std::vector<int> > option(n); // indices in eGroups
+    bool any(false);
+    for (int i=0; i<n; i++)
+        for (size_t j=0; j<eGroups.size(); j++)
+            if (eGroups[j].has_player() && dis2(order[i]->center(), eGroups[j].center()) <= PLAN_RANGE2)
+                option[i].push_back(j), any = true;
+    if (! any) return;
+
+    std::map<std::pair<int, uint64_t>, double> worth; // (target, attackers) -> value of the attack
+    auto value = [&](int target, uint64_t mask) -> double
+    {
+        if (! mask) return 0;
+        auto it = worth.find(std::make_pair(target, mask));
+        if (it != worth.end()) return it->second;
+        CombatState s;
+        s.n = 0;
+        s.homeX = MILITARY_BASE_POS[console->camp()].x, s.homeY = MILITARY_BASE_POS[console->camp()].y;
+        for (int i=0; i<n; i++)
+            if (mask >> i & 1)
+                for (const FUnit *u : order[i]->get_member())
+                    combat_add(s, u->get_entity(), false);
+        for (const EUnit *e : eGroups[target].get_member())
+            if (e->get_kind() != KIND_MINE && e->get_kind() != KIND_OBSERVER)
+                combat_add(s, e->get_entity(), true);
+        return worth[std::make_pair(target, mask)] = combat_rollout(s, COMBAT_FIGHT).score() - PLAN_ATTACK_MARGIN;
+    };
+
+    struct Plan
+    {
+        std::vector<int> pick; // target of order[i], -1 for the cascade
+        double score;
+    };
+    auto attackers = [&](const Plan &p, int target)
+    {
+        uint64_t mask(0);
+        for (size_t i=0; i<p.pick.size(); i++)
+            if (p.pick[i] == target)
+                mask |= 1ull << i;
+        return mask;
+    };
+    std::vector<Plan> beam(1, Plan{ std::vector<int>(), 0 }), next;
+    for (int i=0; i<n && ! out_of_time(PLAN_BUDGET); i++)
+    {
+        next.clear();
+        for (const Plan &p : beam)
+        {
+            next.push_back(p);
+            next.back().pick.push_back(-1);
+            for (int j : option[i])
+            {
+                const uint64_t mask(attackers(p, j));
+                next.push_back(p);
+                next.back().pick.push_back(j);
+                next.back().score += value(j, mask | 1ull << i) - value(j, mask);
+            }
+        }
+        std::stable_sort(next.begin(), next.end(), [](const Plan &a, const Plan &b) { return a.score > b.score; });
+        if ((int)next.size() > PLAN_BEAM) next.resize(PLAN_BEAM);
+        beam.swap(next);
+    }
+
+    const Plan &best = beam.front();
+    RD_LOG(LOG_GROUP_ACTION) << "GroupAction : Conductor : plan of " << best.pick.size() << " / " << n << " groups, score " << best.score << '\n';
+    for (size_t i=0; i<best.pick.size(); i++)
+        if (~best.pick[i] && value(best.pick[i], attackers(best, best.pick[i])) > 0)
+            order[i]->set_planned_target(&eGroups[best.pick[i]]);
+}
+
 void Conductor::update_energy()
 {
-    for (int i=0; i<MINE_NUM; i++)
-        set_energy(MINE_POS[i], std::max(0, get_energy(MINE_POS[i]) - 1));
-    UnitFilter filter;
-    filter.setTypeFilter("mine", "a");
-    for (PUnit *p : console->enemyUnits(filter))
-        set_energy(p->pos, console->unitArg("energy", "c", p));
+    const int now(console->round());
+    for (MineState &m : mines)
+    {
+        const PUnit *got = index.first(m.pos, MINING_RANGE, UnitQuery().enemy().type(KIND_MINE));
+        m.visible = (got ? get_e_unit(got->id)->get_belongs() : NULL);
+        if (! got)
+        {
+            m.energy = std::max(0.0, m.energy - m.drain);
+            continue;
+        }
+        const int energy(console->unitArg("energy", "c", got));
+        if (~m.seenRound && m.seenRound < now)
+            m.drain = m.drain * (1 - MINE_DRAIN_RATE) + (m.energy + m.drain * (now - m.seenRound - 1) - energy) / (now - m.seenRound) * MINE_DRAIN_RATE;
+        m.energy = energy, m.seenRound = now;
+    }
 }
 
 const EGroup *Conductor::mine_visible(const Pos &p) const
 {
     if (p == Pos(-1, -1)) return NULL;
-    UnitFilter filter;
-    filter.setAreaFilter(new Circle(p, MINING_RANGE), "a");
-    filter.setTypeFilter("mine");
-    const auto &got = console->enemyUnits(filter);
-    return (got.empty() ? NULL : conductor.get_e_unit(got.front()->id)->get_belongs());
+    if (~mine_id(p)) return mines[mine_id(p)].visible;
+    const PUnit *got = index.first(p, MINING_RANGE, UnitQuery().enemy().type(KIND_MINE));
+    return (got ? conductor.get_e_unit(got->id)->get_belongs() : NULL);
+}
+
+void Conductor::set_enemy_pos(int id, const Pos &p)
+{
+    if (id >= (int)enemyTrack.size())
+        enemyTrack.resize(id + 1);
+    EnemyTrack &t = enemyTrack[id];
+    const int now(console->round());
+    if (~t.round && t.round < now && now - t.round <= TRACK_GUESS_ROUND)
+    {
+        const int dt(now - t.round);
+        t.vx = t.vx * (1 - TRACK_VELOCITY_RATE) + (double)(p.x - t.pos.x) / dt * TRACK_VELOCITY_RATE;
+        t.vy = t.vy * (1 - TRACK_VELOCITY_RATE) + (double)(p.y - t.pos.y) / dt * TRACK_VELOCITY_RATE;
+    } else if (t.round != now)
+        t.vx = t.vy = 0; // lost for too long, or a new one
+    t.id = id, t.pos = p, t.round = now;
+}
+
+void Conductor::update_influence()
+{
+    RD_PROFILE_SCOPE("Conductor::update_influence");
+    const int now(console->round());
+    influence.begin(now);
+    index.for_each(UnitQuery().friendly().avoid(KIND_MILITARYBASE).avoid(KIND_OBSERVER).avoid(KIND_MINE).alive(), [&](const PUnit *u)
+    {
+        const double view(sqrt(u->view));
+        influence.put(INFLUENCE_FRIEND, u->id, now, u->pos, view, view + INFLUENCE_FALLOFF, table.strength[table_row(u->id)] * ABILITY_FACTOR);
+    });
+    for (const EnemyTrack &t : get_enemy_tracks())
+    {
+        const EUnit *e = get_e_unit(t.id);
+        if (e->get_kind() == KIND_OBSERVER) continue;
+        const PUnit *p = get_p_unit(t.id);
+        const double view(sqrt(p->view)), range(sqrt(p->range));
+        influence.put(INFLUENCE_ENEMY, t.id, now, t.pos, view, view + INFLUENCE_FALLOFF, e->danger_factor() * t.confidence);
+        influence.put(INFLUENCE_THREAT, t.id, now, t.pos, range, sqrt(SAFE_PATH_RANGE2), t.confidence);
+    }
+    influence.end(now);
+}
+
+void Conductor::predict_enemies()
+{
+    RD_PROFILE_SCOPE("Conductor::predict_enemies");
+    // every enemy in a group at once : dizzy ones and those with a friend in range stay, the others chase the friends
+    // in sight of their group, or else keep going as they did. the friends are flat coordinate arrays, and the
+    // group in-sight test is shared by its members, so the distance loops below are plain and vectorizable
+    std::vector<float> fx, fy;
+    index.for_each(UnitQuery().friendly().avoid(KIND_MINE).alive(), [&](const PUnit *u)
+    {
+        fx.push_back(u->pos.x), fy.push_back(u->pos.y);
+    });
+    const int n(fx.size()), now(console->round());
+    std::vector<float> d2(n);
+    std::vector<unsigned char> inSight(n);
+    std::vector<int> sight;
+    auto distances = [&](const Pos &p)
+    {
+        const float x(p.x), y(p.y);
+        for (int i=0; i<n; i++)
+            d2[i] = (fx[i] - x) * (fx[i] - x) + (fy[i] - y) * (fy[i] - y);
+    };
+
+    for (const EGroup &g : eGroups)
+    {
+        std::fill(inSight.begin(), inSight.end(), 0);
+        for (const EUnit *e : g.get_member())
+        {
+            distances(e->get_entity()->pos);
+            const float view(e->get_entity()->view);
+            for (int i=0; i<n; i++)
+                inSight[i] |= d2[i] <= view;
+        }
+        sight.clear();
+        for (int i=0; i<n; i++)
+            if (inSight[i])
+                sight.push_back(i);
+
+        for (const EUnit *e : g.get_member())
+        {
+            const PUnit *p = e->get_entity();
+            const int id(p->id);
+            if (id >= (int)predictRound.size())
+                predictPos.resize(id + 1), predictRound.resize(id + 1, -1);
+            predictRound[id] = now, predictPos[id] = p->pos;
+            if (has_buff(p, BUFF_DIZZY))
+            {
+                RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : EUnit : " << id << " cannot move" << '\n';
+                continue;
+            }
+            distances(p->pos);
+            const float range(p->range);
+            bool near(false);
+            for (int i=0; i<n; i++)
+                near |= d2[i] <= range;
+            if (near)
+            {
+                RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : EUnit : " << id << " is likely to stand still" << '\n';
+                continue;
+            }
+
+            const EnemyTrack *t = get_enemy_track(id);
+            const bool tracked(t && t->round == now);
+            double x(p->pos.x), y(p->pos.y);
+            if (! sight.empty())
+            {
+                // one step of at most the speed, towards the mean direction of the friends in sight
+                double minDis(sqrt(p->speed)), sx(0), sy(0);
+                for (int i : sight)
+                    minDis = std::min(minDis, sqrt((double)d2[i]));
+                for (int i : sight)
+                {
+                    const double d(std::max(sqrt((double)d2[i]), 1e-9));
+                    sx += (fx[i] - p->pos.x) * minDis / d, sy += (fy[i] - p->pos.y) * minDis / d;
+                }
+                x += sx / sight.size(), y += sy / sight.size();
+                if (tracked && (t->vx != 0 || t->vy != 0))
+                {
+                    x = x * (1 - PREDICT_VELOCITY_RATE) + (p->pos.x + t->vx) * PREDICT_VELOCITY_RATE;
+                    y = y * (1 - PREDICT_VELOCITY_RATE) + (p->pos.y + t->vy) * PREDICT_VELOCITY_RATE;
+                }
+            } else if (tracked) // nobody around to chase, so it keeps going as it did
+                x += t->vx, y += t->vy;
+            predictPos[id] = Pos(std::max(0, std::min(MAP_SIZE - 1, (int)lround(x))), std::max(0, std::min(MAP_SIZE - 1, (int)lround(y))));
+            if (! sight.empty())
+            {
+                RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : EUnit : " << id << " is likely to move to " << predictPos[id] << '\n';
+            }
+        }
+    }
 }
 
 void Conductor::update_enemy_pos()
 {
-    UnitFilter filter;
-    filter.setAvoidFilter("militarybase", "a");
-    filter.setAvoidFilter("mine", "a");
-    filter.setHpFilter(1, 0x7fffffff);
-    for (PUnit *p : console->enemyUnits(filter))
+    index.for_each(UnitQuery().enemy().avoid(KIND_MILITARYBASE).avoid(KIND_MINE).alive().not_reviving(), [&](const PUnit *p)
     {
-        if (console->getBuff("reviving", p)) continue;
         set_enemy_pos(p->id, p->pos);
-    }
+    });
+
+    const int now(console->round());
+    enemyKnown.clear();
+    for (const EnemyTrack &t : enemyTrack)
+        if (~t.round && t.round >= now - POS_MEM_ROUND)
+        {
+            enemyKnown.push_back(t);
+            enemyKnown.back().pos = t.guess(now);
+            enemyKnown.back().confidence = 1 - (double)(now - t.round) / (POS_MEM_ROUND + 1);
+        }
+
+    // counting sort into cells
+    auto cell = [](const Pos &p) { return p.x / KNOWN_CELL_SIZE * KNOWN_GRID_SIZE + p.y / KNOWN_CELL_SIZE; };
+    knownCellStart.assign(KNOWN_GRID_SIZE * KNOWN_GRID_SIZE + 1, 0);
+    for (const EnemyTrack &t : enemyKnown)
+        knownCellStart[cell(t.pos) + 1]++;
+    for (int i=0; i<KNOWN_GRID_SIZE*KNOWN_GRID_SIZE; i++)
+        knownCellStart[i+1] += knownCellStart[i];
+    knownCellItem.resize(enemyKnown.size());
+    std::vector<int> fill(knownCellStart.begin(), knownCellStart.end() - 1);
+    for (size_t i=0; i<enemyKnown.size(); i++)
+        knownCellItem[fill[cell(enemyKnown[i].pos)]++] = i;
 }
 
-std::map<int, Pos> Conductor::get_enemy_pos() const
+int Conductor::count_enemy_tracks(const Pos &c, int r2) const
 {
-    std::map<int, Pos> ret;
-    for (auto i=enemyPos.begin(); i!=enemyPos.end(); i++)
-        if (i->second.second >= console->round() - POS_MEM_ROUND)
-            ret[i->first] = i->second.first;
+    const int r((int)ceil(sqrt((double)r2)));
+    auto clamp = [](int x) { return std::max(0, std::min(KNOWN_GRID_SIZE - 1, x / KNOWN_CELL_SIZE)); };
+    int ret(0);
+    for (int x=clamp(c.x - r); x<=clamp(c.x + r); x++)
+        for (int y=clamp(c.y - r); y<=clamp(c.y + r); y++)
+        {
+            const int k(x * KNOWN_GRID_SIZE + y);
+            for (int i=knownCellStart[k]; i<knownCellStart[k+1]; i++)
+                if (dis2(enemyKnown[knownCellItem[i]].pos, c) <= r2)
+                    ret++;
+        }
     return ret;
 }
 
 void Conductor::check_alarm()
 {
-    UnitFilter filter;
-    filter.setAreaFilter(new Circle(MILITARY_BASE_POS[console->camp()], ALARM_RANGE2), "a");
-    filter.setHpFilter(1, 0x7fffffff);
-    if (console->enemyUnits(filter).empty()) return;
-    mylog << "BaseStatus : ALARM !!!" << std::endl;
+    if (! index.any(MILITARY_BASE_POS[console->camp()], ALARM_RANGE2, UnitQuery().enemy().alive())) return;
+    RD_LOG(LOG_BASE_STATUS) << "BaseStatus : ALARM !!!" << '\n';
     set_alarm();
 }
 
 void Conductor::check_buy_hero()
 {
+    RD_PROFILE_SCOPE("Conductor::check_buy_hero");
     while (true)
     {
         if (need_buy_hero() < BUY_HERO_THRESHOLD) return;
@@ -2026,26 +3630,23 @@ void Conductor::check_buy_hero()
 
 void Conductor::check_buyback_hero()
 {
+    RD_PROFILE_SCOPE("Conductor::check_buyback_hero");
     if (! conductor.alarmed()) return;
-    UnitFilter live;
-    live.setAreaFilter(new Circle(MILITARY_BASE_POS[console->camp()], MILITARY_BASE_RANGE), "a");
-    live.setAvoidFilter("militarybase");
-    live.setHpFilter(1, 0x7fffffff);
-    if (console->friendlyUnits(live).empty()) return;
+    if (! index.any(MILITARY_BASE_POS[console->camp()], MILITARY_BASE_RANGE, UnitQuery().friendly().avoid(KIND_MILITARYBASE).alive())) return;
     while (true)
     {
         bool did(false);
-        for (const PUnit *item : console->friendlyUnits())
+        index.for_each(UnitQuery().friendly(), [&](const PUnit *item)
         {
-            if (! console->getBuff("reviving", item) || console->getBuff("reviving", item)->timeLeft <= 5) continue;
+            if (conductor.buff_left(item, BUFF_REVIVING) <= 5) return;
             int cost = BUYBACK_COST_PER_LEVEL * item->level + BUYBACK_COST_BASE;
             if (cost < console->gold() - console->goldCostCurrentRound())
             {
                 did = true;
                 console->buyBackHero(item);
-                mylog << "Buy Back " << item->id << std::endl;
+                RD_LOG(LOG_BASE_STATUS) << "Buy Back " << item->id << '\n';
             }
-        }
+        });
         if (! did) return;
     }
 }
@@ -2057,20 +3658,17 @@ void Conductor::check_callback_hero()
 
 void Conductor::check_upgrade_hero()
 {
+    RD_PROFILE_SCOPE("Conductor::check_upgrade_hero");
     while (true)
     {
-        UnitFilter filter;
-        filter.setAreaFilter(new Circle(MILITARY_BASE_POS[console->camp()], LEVELUP_RANGE), "a");
-        filter.setAvoidFilter("militarybase");
-        filter.setHpFilter(1, 0x7fffffff);
         const PUnit *target(0);
         int cost;
-        for (const PUnit *item : console->friendlyUnits(filter))
+        index.for_each(MILITARY_BASE_POS[console->camp()], LEVELUP_RANGE, UnitQuery().friendly().avoid(KIND_MILITARYBASE).alive(), [&](const PUnit *item)
         {
             int _cost = LEVELUP_COST_PER_LEVEL * item->level + LEVELUP_COST_BASE;
             if (! target || _cost < cost)
                 cost = _cost, target = item;
-        }
+        });
         if (target && cost < console->gold() - console->goldCostCurrentRound())
             console->buyHeroLevel(target);
         else
@@ -2080,19 +3678,15 @@ void Conductor::check_upgrade_hero()
 
 void Conductor::check_base_attack()
 {
-    UnitFilter filter;
-    filter.setAreaFilter
-        (new Circle(MILITARY_BASE_POS[console->camp()], MILITARY_BASE_RANGE), "a");
-    filter.setHpFilter(1, 0x7fffffff);
+    RD_PROFILE_SCOPE("Conductor::check_base_attack");
     const PUnit *target = 0;
     double cur(0);
-    for (PUnit *u : console->enemyUnits(filter))
+    index.for_each(MILITARY_BASE_POS[console->camp()], MILITARY_BASE_RANGE, UnitQuery().enemy().alive().not_reviving(), [&](const PUnit *u)
     {
-        if (console->getBuff("reviving", u)) continue;
         double _cur(conductor.get_e_unit(u->id)->value_factor());
         if (! target || _cur > cur)
             cur = _cur, target = u;
-    }
+    });
     if (target)
         console->baseAttack(target);
 }
@@ -2101,45 +3695,211 @@ void Conductor::make_p_units()
 {
     for (const auto &u : info->units)
     {
-        if (pUnits.count(u.id) && pUnits[u.id].second)
-            delete pUnits[u.id].first;
-        pUnits[u.id] = std::make_pair(const_cast<PUnit*>(&u), false);
+        if (u.id >= (int)pUnits.size())
+            pUnits.resize(u.id + 1, 0);
+        pUnits[u.id] = const_cast<PUnit*>(&u);
     }
 }
 
 void Conductor::save_p_units()
 {
-    for (auto i=pUnits.begin(); i!=pUnits.end(); i++)
-        i->second = std::make_pair(new PUnit(*(i->second.first)), true);
+    // new slots may move pUnitSaved, so pointers are set after all of them exist
+    const PUnit *oldData = pUnitSaved.data();
+    for (const auto &u : info->units)
+    {
+        if (u.id >= (int)pUnitSlot.size())
+            pUnitSlot.resize(u.id + 1, -1);
+        if (~pUnitSlot[u.id])
+            pUnitSaved[pUnitSlot[u.id]] = u;
+        else
+        {
+            pUnitSlot[u.id] = pUnitSaved.size();
+            pUnitSaved.push_back(u);
+        }
+    }
+    if (pUnitSaved.data() != oldData)
+    {
+        for (size_t id=0; id<pUnitSlot.size(); id++)
+            if (~pUnitSlot[id])
+                pUnits[id] = &pUnitSaved[pUnitSlot[id]];
+    } else
+        for (const auto &u : info->units)
+            pUnits[u.id] = &pUnitSaved[pUnitSlot[u.id]];
+}
+
+void Conductor::make_blocks()
+{
+    if (! ~staticBlockCnt)
+    {
+        for(int k = 0; k < MINE_NUM; ++k)
+            for(int i = - MINE_VOLUME + 1; i < MINE_VOLUME; ++i)
+                for(int j = - MINE_VOLUME + 1; j < MINE_VOLUME; ++j)
+                    blocks.push_back(Pos(MINE_POS[k].x+i, MINE_POS[k].y+j));
+        for(int k = 0; k < MILITARY_BASE_NUM; ++k)
+            blocks.push_back(MILITARY_BASE_POS[k]);
+        staticBlockCnt = blocks.size();
+    }
+    blocks.resize(staticBlockCnt);
+    std::fill(unitBlock.begin(), unitBlock.end(), -1);
+    for (const PUnit &u : info->units)
+    {
+        if (u.id >= (int)unitBlock.size())
+            unitBlock.resize(u.id + 1, -1);
+        unitBlock[u.id] = blocks.size();
+        blocks.push_back(u.pos);
+    }
 }
 
-Pos Conductor::reachable(const FUnit *from, const Pos &to) const
+Pos Conductor::reachable(const FUnit *from, const Pos &_to)
 {
-    std::vector<Pos> blocks, path;
-    for(int j = 0; j < info->units.size(); ++j)
-        if (info->units[j].id != from->get_id())
-            blocks.push_back(info->units[j].pos);
-    for(int k = 0; k < MINE_NUM; ++k)
-        for(int i = - MINE_VOLUME + 1; i < MINE_VOLUME; ++i)
-            for(int j = - MINE_VOLUME + 1; j < MINE_VOLUME; ++j)
-                blocks.push_back(Pos(MINE_POS[k].x+i, MINE_POS[k].y+j));
-    for(int k = 0; k < MILITARY_BASE_NUM; ++k)
-        blocks.push_back(MILITARY_BASE_POS[k]);
+    RD_PROFILE_SCOPE("Conductor::reachable");
+    // positions don't change in a round, so the result is shared by every query of the same unit and destination.
+    // no path ends off the map, so the destination is clamped to it first, which keeps the key unique
+    static Memo<Pos> memo("Conductor::reachable");
+    const Pos to(std::min(std::max(_to.x, 0), MAP_SIZE - 1), std::min(std::max(_to.y, 0), MAP_SIZE - 1));
+    const int id(from->get_id()), param(to.x << 16 | to.y);
+    if (const Pos *ret = memo.find(id, param)) return *ret;
+
+    // leave the unit itself out by swapping it to the back, and swap it back afterwards
+    const int k(id < (int)unitBlock.size() ? unitBlock[id] : -1);
+    Pos self;
+    if (~k)
+    {
+        self = blocks[k];
+        std::swap(blocks[k], blocks.back());
+        blocks.pop_back();
+    }
+    std::vector<Pos> path;
     findShortestPath(*map, from->get_entity()->pos, to, blocks, path);
-    return path.back();
+    if (~k)
+    {
+        blocks.push_back(self);
+        std::swap(blocks[k], blocks.back());
+    }
+    return memo.store(id, param, path.back());
+}
+
+void Conductor::safe_path(int id, const Pos &start, const Pos &dest, std::vector<Pos> &_path)
+{
+    get_threat_cost();
+    // the blocks of units come first, so the unit is left out as in reachable
+    const int k(id < (int)unitBlock.size() ? unitBlock[id] : -1);
+    Pos self;
+    if (~k)
+    {
+        self = safeBlocks[k];
+        std::swap(safeBlocks[k], safeBlocks.back());
+        safeBlocks.pop_back();
+    }
+    findShortestPath(*map, start, dest, safeBlocks, _path);
+    if (~k)
+    {
+        safeBlocks.push_back(self);
+        std::swap(safeBlocks[k], safeBlocks.back());
+    }
+}
+
+const std::vector<float> &Conductor::get_threat_cost()
+{
+    // built at the first use in a round, then shared by every findSafePath
+    if (threatEpoch == memoEpoch) return threatCost;
+    threatEpoch = memoEpoch;
+    threatCost.resize(MAP_SIZE * MAP_SIZE);
+    safeBlocks = blocks;
+    for (int x=0; x<MAP_SIZE; x++)
+        for (int y=0; y<MAP_SIZE; y++)
+        {
+            const float cost((SAFE_PATH_COST + SAFE_PATH_IN_RANGE_COST) * influence.interpolate(INFLUENCE_THREAT, x, y));
+            threatCost[x * MAP_SIZE + y] = cost;
+            if (cost >= SAFE_PATH_BLOCK_COST)
+                safeBlocks.push_back(Pos(x, y));
+        }
+    return threatCost;
+}
+
+int Conductor::table_row(int id)
+{
+    int ret(table.row(id));
+    if (! ~ret)
+    {
+        ret = table.add(get_p_unit(id));
+        table.compute(ret, ret + 1);
+    }
+    return ret;
+}
+
+void Conductor::apply_orders()
+{
+    RD_PROFILE_SCOPE("Conductor::apply_orders");
+    std::vector<Order> _orders;
+    _orders.swap(orders); // taken once, also when called again after an error
+
+    // console->move runs the path search, which the time checks in Conductor::work never saw.
+    // out of time, units walk on along their last paths, or straight with RD_SAFE_ASTAR
+    for (const Order &o : _orders)
+        if (o.target)
+            console->attack(o.target, o.unit);
+        else
+        {
+            curOrder = &o;
+            if (out_of_time())
+                curSearch = SAFE_ASTAR_ON ? findDirectPath : findKeptPath;
+            else if (o.safe)
+                curSearch = findSafePath;
+            else
+                curSearch = findShortestPath;
+            console->changeShortestPathFunc(findOrderPath);
+            console->move(o.pos, o.unit);
+            console->changeShortestPathFunc(findShortestPath);
+            curOrder = 0;
+        }
+    RD_LOG(LOG_UNIT_ACTION) << "UnitAction : " << _orders.size() << " orders applied" << '\n';
+}
+
+void Conductor::keep_path(int id, const Pos &dest, const std::vector<Pos> &path)
+{
+    if (id >= (int)keptPath.size())
+        keptPath.resize(id + 1);
+    keptPath[id].first = dest, keptPath[id].second = path;
+}
+
+bool Conductor::kept_path(int id, const Pos &start, const Pos &dest, std::vector<Pos> &_path) const
+{
+    if (id < 0 || id >= (int)keptPath.size() || keptPath[id].first != dest)
+        return false;
+    const std::vector<Pos> &path = keptPath[id].second;
+    const auto it = std::find(path.begin(), path.end(), start);
+    if (it == path.end())
+        return false;
+    _path.assign(it, path.end());
+    return true;
 }
 
 void Conductor::init(const PMap &_map, const PPlayerInfo &_info, PCommand &_cmd)
 {
+    RD_PROFILE_SCOPE("Conductor::init");
     map = &_map, info = &_info, cmd = &_cmd;
+    roundStart = std::chrono::steady_clock::now();
+    orders.clear(), safePath = false;
+    memo_new_round();
     make_p_units();
+    make_blocks();
+    table.clear();
+    for (const PUnit &u : _info.units)
+        table.add(&u);
+    table.compute(0, table.size());
+    index.build(_info, table);
     enemy_make_groups();
     update_energy();
     update_enemy_pos();
+    predict_enemies();
+    update_influence();
+    trace_round();
 }
 
 void Conductor::work()
 {
+    RD_PROFILE_SCOPE("Conductor::work");
     check_alarm();
     check_buy_hero();
     check_buyback_hero();
@@ -2147,24 +3907,23 @@ void Conductor::work()
     check_upgrade_hero();
     check_base_attack();
 
-    UnitFilter filter;
-    filter.setAvoidFilter("militarybase", "a");
-    filter.setAvoidFilter("observer", "a");
-    filter.setHpFilter(1, 0x7fffffff);
-    for (const PUnit *u : console->friendlyUnits(filter))
+    index.for_each(UnitQuery().friendly().avoid(KIND_MILITARYBASE).avoid(KIND_OBSERVER).alive(), [&](const PUnit *u)
     {
         FUnit *obj = conductor.get_f_unit(u->id);
-        mylog << "UnitStatus : Unit " << u->id << " : name = " << u->name << std::endl;
+        RD_LOG(LOG_UNIT_STATUS) << "UnitStatus : Unit " << u->id << " : name = " << u->name << '\n';
         if (! obj->get_belongs())
         {
             fGroups.push_back(FGroup());
             fGroups.back().add_member(obj);
         }
-    }
+    });
     
-    for (size_t i=0; i<fGroups.size(); i++) // do use id
-        if (! fGroups[i].get_member().empty())
-            if (! fGroups[i].checkJoin()) fGroups[i].checkSplit();
+    {
+        RD_PROFILE_SCOPE("Conductor::work join/split");
+        for (size_t i=0; i<fGroups.size(); i++) // do use id
+            if (! fGroups[i].get_member().empty())
+                if (! fGroups[i].checkJoin()) fGroups[i].checkSplit();
+    }
     for (auto i=fGroups.begin(); i!=fGroups.end(); i++)
         if (i->get_member().empty())
         {
@@ -2176,13 +3935,146 @@ void Conductor::work()
             break;
         }
     
+    assign_mines();
+
+    // most urgent first, so the groups that run out of time are the quiet ones
+    std::vector<FGroup*> order;
     for (FGroup &g : fGroups)
-        g.action();
+        order.push_back(&g);
+    std::stable_sort(order.begin(), order.end(), [](const FGroup *a, const FGroup *b) { return a->priority() > b->priority(); });
+    if (PLAN_ON) plan_groups(order);
+    for (FGroup *g : order)
+        if (out_of_time())
+            g->fallback();
+        else
+            g->action();
+    apply_orders();
 }
 
 void Conductor::finish()
 {
+    RD_PROFILE_SCOPE("Conductor::finish");
     save_p_units();
+    log_memo_stats();
+    trace_groups();
+}
+
+/********************************/
+/*     Spatial Index Implement  */
+/********************************/
+
+UnitKind unit_kind(const PUnit *u)
+{
+    std::string name = lowerCase(u->name);
+    if (name == "hammerguard") return KIND_HAMMERGUARD;
+    if (name == "master") return KIND_MASTER;
+    if (name == "berserker") return KIND_BERSERKER;
+    if (name == "scouter") return KIND_SCOUTER;
+    if (name == "observer") return KIND_OBSERVER;
+    if (name == "mine") return KIND_MINE;
+    if (name == "militarybase") return KIND_MILITARYBASE;
+    if (name == "roshan") return KIND_ROSHAN;
+    if (name == "dragon") return KIND_DRAGON;
+    return KIND_OTHER;
+}
+
+void UnitIndex::build(const PPlayerInfo &info, const UnitTable &table)
+{
+    entries.clear();
+    for (const PUnit &u : info.units)
+    {
+        const int r(entries.size());
+        Entry e;
+        e.unit = &u;
+        e.pos = u.pos;
+        e.camp = (u.camp == console->camp() ? CAMP_FRIENDLY : CAMP_ENEMY);
+        e.kind = unit_kind(&u);
+        e.alive = u.hp >= 1;
+        e.reviving = table.has_buff(r, BUFF_REVIVING);
+        entries.push_back(e);
+    }
+
+    // counting sort into cells
+    cellStart.assign(GRID_SIZE * GRID_SIZE + 1, 0);
+    for (const Entry &e : entries)
+        cellStart[cell_of(e.pos.x) * GRID_SIZE + cell_of(e.pos.y) + 1]++;
+    for (int i=0; i<GRID_SIZE*GRID_SIZE; i++)
+        cellStart[i+1] += cellStart[i];
+    cellItem.resize(entries.size());
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i=0; i<entries.size(); i++)
+    {
+        const Entry &e = entries[i];
+        cellItem[fill[cell_of(e.pos.x) * GRID_SIZE + cell_of(e.pos.y)]++] = i;
+    }
+}
+
+/********************************/
+/*     Unit Table Implement     */
+/********************************/
+
+void UnitTable::clear()
+{
+    std::fill(rowOf.begin(), rowOf.end(), -1);
+    id.clear(), kind.clear(), hero.clear(), moves.clear(), buffs.clear(), buffLeft.clear();
+    hp.clear(), maxHp.clear(), hpRegen.clear(), mp.clear(), maxMp.clear(), mpRegen.clear(), atk.clear(), def.clear(), speed.clear();
+    strength.clear(), valueDanger.clear(), valueDiv.clear();
+}
+
+int UnitTable::add(const PUnit *u)
+{
+    if (u->id >= (int)rowOf.size())
+        rowOf.resize(u->id + 1, -1);
+    const int ret(id.size());
+    rowOf[u->id] = ret;
+
+    console->selectUnit(u);
+    id.push_back(u->id);
+    kind.push_back(unit_kind(u));
+    hero.push_back(u->isHero());
+    moves.push_back(! u->isBase() && ! u->isMine());
+    unsigned mask(0);
+    for (int b=0; b<BUFF_NUM; b++)
+    {
+        const PBuff *buff = console->getBuff(BUFF_NAME[b], u);
+        if (buff)
+            mask |= buff_bit((BuffType) b);
+        buffLeft.push_back(buff ? buff->timeLeft : -1);
+    }
+    buffs.push_back(mask);
+    hp.push_back(console->unitArg("hp","c"));
+    maxHp.push_back(console->unitArg("hp","m"));
+    hpRegen.push_back(console->unitArg("hp","r"));
+    mp.push_back(console->unitArg("mp","c"));
+    maxMp.push_back(console->unitArg("mp","m"));
+    mpRegen.push_back(console->unitArg("mp","r"));
+    atk.push_back(console->unitArg("atk","c"));
+    def.push_back(console->unitArg("def","c"));
+    speed.push_back(console->unitArg("speed","c"));
+    console->selectUnit(0);
+
+    strength.push_back(0), valueDanger.push_back(0), valueDiv.push_back(0);
+    return ret;
+}
+
+void UnitTable::compute(int from, int to)
+{
+    // no calls and no early exits, so the loop stays a straight pass over the columns
+    for (int i=from; i<to; i++)
+    {
+        const bool observer(kind[i] == KIND_OBSERVER), winordie(has_buff(i, BUFF_WINORDIE));
+        const double hpLeft(std::max(winordie && ! observer ? maxHp[i] : hp[i], 0.0));
+        const double ava(observer ? hpLeft * HP_STRENGTH_FACTOR * OBSERVER_FACTOR_RATE :
+                         hpLeft * HP_STRENGTH_FACTOR + (hero[i] ? std::max(mp[i], 0.0) * MP_STRENGTH_FACTOR : 0.0));
+        const double tot(maxHp[i] * HP_STRENGTH_FACTOR + (! observer && hero[i] ? maxMp[i] * MP_STRENGTH_FACTOR : 0.0));
+        const double val(observer ? def[i] * DEF_STRENGTH_FACTOR :
+                         hpRegen[i] * HP_RATE_STRENGTH_FACTOR + (hero[i] ? mpRegen[i] * MP_RATE_STRENGTH_FACTOR : 0.0) +
+                         atk[i] * ATK_STRENGTH_FACTOR + def[i] * DEF_STRENGTH_FACTOR + (moves[i] ? speed[i] * SPEED_STRENGTH_FACTOR : 0.0));
+        strength[i] = kind[i] == KIND_MINE ? 0.0 : val * ava / tot;
+
+        valueDanger[i] = observer ? 0.0 : (hero[i] ? std::max(mp[i], 0.0) * MP_VALUE_FACTOR : 0.0) + atk[i] * ATK_VALUE_FACTOR;
+        valueDiv[i] = inf_1(std::max(hp[i], 0.0) * HP_VALUE_FACTOR * (def[i] * DEF_VALUE_FACTOR) / 5000);
+    }
 }
 
 /********************************/
@@ -2191,22 +4083,138 @@ void Conductor::finish()
 
 void findSafePath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path)
 {
-    // 将可见敌人以及记忆x回合的敌人位置周边225平方距离，但不在目标400平方距离内的，周边100，但不在200内的，加入blocks
-    // 若找不到则fallback到原有pathfinder
-    std::vector<Pos> newBlocks = blocks;
-    for (const auto &unit : conductor.get_enemy_pos())
-        if (lowerCase(conductor.get_p_unit(unit.first)->name) != "observer")
-            for (int i=-15; i<=15; i++)
-                for (int j=-15+std::abs(i); j<=15-std::abs(i); j++)
-                {
-                    Pos _p(unit.second + Pos(i, j));
-                    if (_p.x < 0 || _p.y < 0 || _p.x >= MAP_SIZE || _p.y >= MAP_SIZE) continue;
-                    if (dis2(_p, dest) > 400 || dis2(_p, dest) > 200 && dis2(_p, unit.second) <= 100)
-                        newBlocks.push_back(_p);
-                }
-    findShortestPath(map, start, dest, newBlocks, _path);
-    if (dis2(_path.back(), dest) >= 16)
+    RD_PROFILE_SCOPE("findSafePath");
+    if (SAFE_ASTAR_ON)
+    {
+        if (! safe_path_search(map, start, dest, blocks, _path))
+            findShortestPath(map, start, dest, blocks, _path);
+        return;
+    }
+    // threatened cells are blocks, the same for every move of the round. near dest, or already under threat,
+    // there is no going round it, so the shortest way it is
+    const std::vector<float> &threat = conductor.get_threat_cost();
+    const bool inside(start.x >= 0 && start.y >= 0 && start.x < MAP_SIZE && start.y < MAP_SIZE);
+    if (! curOrder || ! inside || dis2(start, dest) <= SAFE_PATH_NEAR_DIS2 || threat[start.x * MAP_SIZE + start.y] >= SAFE_PATH_BLOCK_COST)
+    {
         findShortestPath(map, start, dest, blocks, _path);
+        return;
+    }
+    // short of dest, the unit goes as close as the threat lets it. only if that is not a single step is the
+    // shortest way searched as well
+    conductor.safe_path(curOrder->unit->id, start, dest, _path);
+    if (_path.size() <= 1 && start != dest && ! conductor.out_of_time())
+        findShortestPath(map, start, dest, blocks, _path);
+}
+
+void findDirectPath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path)
+{
+    // straight towards dest, stopping before the first blocked cell or step of more than 1 in height
+    _path.assign(1, start);
+    const int n(std::max(std::abs(dest.x - start.x), std::abs(dest.y - start.y)));
+    for (int i=1; i<=std::min(n, DIRECT_PATH_STEPS); i++)
+    {
+        const Pos p(start.x + (int)lround((double)(dest.x - start.x) * i / n), start.y + (int)lround((double)(dest.y - start.y) * i / n));
+        if (p.x < 0 || p.y < 0 || p.x >= MAP_SIZE || p.y >= MAP_SIZE) break;
+        if (std::find(blocks.begin(), blocks.end(), p) != blocks.end()) break;
+        if (std::abs(map.getHeight(p.x, p.y) - map.getHeight(_path.back().x, _path.back().y)) > 1) break;
+        _path.push_back(p);
+    }
+}
+
+void findKeptPath(const PMap &, Pos start, Pos dest, const std::vector<Pos> &, std::vector<Pos> &_path)
+{
+    if (! curOrder || ! conductor.kept_path(curOrder->unit->id, start, dest, _path))
+        _path.assign(1, start);
+}
+
+void findOrderPath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path)
+{
+    curSearch(map, start, dest, blocks, _path);
+    if (curOrder)
+        conductor.keep_path(curOrder->unit->id, dest, _path);
+}
+
+bool safe_path_search(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &_path)
+{
+    // A* on 8-neighbour grid, where cells around remembered enemies (get_threat_cost) are expensive rather than blocked.
+    // the cost is waived gradually near dest: full beyond 400, half within 400, none within 200.
+    // gives up (for findShortestPath) only if dest turns out unreachable here, or when the round is out of time.
+    // ASSUMPTION: a step is passable iff the heights differ by at most 1, like the observer placement check in Scouter
+    static std::vector<int> blockStamp(MAP_SIZE * MAP_SIZE), openStamp(MAP_SIZE * MAP_SIZE), closeStamp(MAP_SIZE * MAP_SIZE), from(MAP_SIZE * MAP_SIZE);
+    static std::vector<double> g(MAP_SIZE * MAP_SIZE);
+    static std::vector<std::pair<double, int> > open; // (f, cell) as a min-heap
+    static int stamp = 0;
+    stamp++;
+
+    auto inside = [](const Pos &p) { return p.x >= 0 && p.y >= 0 && p.x < MAP_SIZE && p.y < MAP_SIZE; };
+    auto h = [&](const Pos &p)
+    {
+        int dx(std::abs(p.x - dest.x)), dy(std::abs(p.y - dest.y));
+        return std::max(dx, dy) + (sqrt(2.0) - 1) * std::min(dx, dy);
+    };
+    if (! inside(start) || conductor.out_of_time())
+        return false;
+    for (const Pos &p : blocks)
+        if (inside(p))
+            blockStamp[p.x * MAP_SIZE + p.y] = stamp;
+    auto passable = [&](const Pos &p) { return inside(p) && blockStamp[p.x * MAP_SIZE + p.y] != stamp; };
+
+    // a blocked dest (e.g. a mine center) is never reached and the search would drain the whole map,
+    // so stop at the first cell as close as the nearest unblocked one. cells beyond the ring have h > R
+    double stopH(0);
+    if (! passable(dest))
+    {
+        const int R(3);
+        double ringH(R + 1);
+        for (int dx=-R; dx<=R; dx++)
+            for (int dy=-R; dy<=R; dy++)
+                if (passable(Pos(dest.x + dx, dest.y + dy)))
+                    ringH = std::min(ringH, h(Pos(dest.x + dx, dest.y + dy)));
+        stopH = ringH <= R ? ringH : -1;
+    }
+
+    const std::vector<float> &threat = conductor.get_threat_cost();
+    const int s(start.x * MAP_SIZE + start.y);
+    int best(s);
+    double bestH(h(start));
+    g[s] = 0, from[s] = -1, openStamp[s] = stamp;
+    open.clear();
+    open.push_back(std::make_pair(bestH, s));
+    while (! open.empty())
+    {
+        std::pop_heap(open.begin(), open.end(), std::greater<std::pair<double, int> >());
+        const int c = open.back().second;
+        open.pop_back();
+        if (closeStamp[c] == stamp) continue;
+        closeStamp[c] = stamp;
+        const Pos p(c / MAP_SIZE, c % MAP_SIZE);
+        if (h(p) < bestH)
+            best = c, bestH = h(p);
+        if (p == dest || h(p) <= stopH) break;
+        for (int dx=-1; dx<=1; dx++)
+            for (int dy=-1; dy<=1; dy++)
+            {
+                const Pos q(p.x + dx, p.y + dy);
+                if ((! dx && ! dy) || ! passable(q)) continue;
+                if (dx && dy && (! passable(Pos(p.x + dx, p.y)) || ! passable(Pos(p.x, p.y + dy)))) continue; // no corner cutting
+                if (std::abs(map.getHeight(q.x, q.y) - map.getHeight(p.x, p.y)) > 1) continue;
+                const int qc(q.x * MAP_SIZE + q.y), d2(dis2(q, dest));
+                const double waive(d2 > 400 ? 1.0 : d2 > 200 ? 0.5 : 0.0);
+                const double cost(g[c] + (dx && dy ? sqrt(2.0) : 1.0) * (1 + threat[qc] * waive));
+                if (closeStamp[qc] == stamp || (openStamp[qc] == stamp && g[qc] <= cost)) continue;
+                g[qc] = cost, from[qc] = c, openStamp[qc] = stamp;
+                open.push_back(std::make_pair(cost + h(q), qc));
+                std::push_heap(open.begin(), open.end(), std::greater<std::pair<double, int> >());
+            }
+    }
+
+    if (dis2(Pos(best / MAP_SIZE, best % MAP_SIZE), dest) >= 16)
+        return false;
+    _path.clear();
+    for (int c=best; ~c; c=from[c])
+        _path.push_back(Pos(c / MAP_SIZE, c % MAP_SIZE));
+    std::reverse(_path.begin(), _path.end());
+    return true;
 }
 
 } // namespace RD_NAMESPACE
@@ -2221,9 +4229,10 @@ void player_ai(const PMap &map, const PPlayerInfo &info, PCommand &cmd)
     
     auto startTime = std::chrono::system_clock::now();
     console = new Console(map, info, cmd);
+    const int camp(console->camp()), round(console->round()); // for use after console is gone
     srand(conductor.random(0, 0xffffffff));
-    mylog << "Round " << console->round() << std::endl;
-    mylog << "Camp " << console->camp() << std::endl;
+    RD_LOG(LOG_ROUND) << "Round " << console->round() << '\n';
+    RD_LOG(LOG_ROUND) << "Camp " << console->camp() << '\n';
 
     try
     {
@@ -2232,8 +4241,9 @@ void player_ai(const PMap &map, const PPlayerInfo &info, PCommand &cmd)
         conductor.finish();
     } catch (const std::exception &e)
     {
-        mylog << "Caught an error !!!!" << std::endl;
-        mylog << e.what() << std::endl;
+        RD_LOG(LOG_ERROR) << "Caught an error !!!!" << '\n';
+        RD_LOG(LOG_ERROR) << e.what() << '\n';
+        conductor.apply_orders(); // the ones made before the error
     }
 
     delete console;
@@ -2242,11 +4252,19 @@ void player_ai(const PMap &map, const PPlayerInfo &info, PCommand &cmd)
     auto endTime = std::chrono::system_clock::now();
     double duration = std::chrono::duration<double>(endTime - startTime).count();
     assert(duration < 0.1);
-    mylog << "TimeConsumed : " << duration << "s" << std::endl;
+    RD_LOG(LOG_ROUND) << "TimeConsumed : " << duration << "s" << '\n';
+    tracer.put(TRACE_TIME, TraceTime{ (float) duration });
+    flush_log();
+    tracer.flush();
+
+    static ProfileStat total("player_ai");
+    if (PROFILE_ON)
+    {
+        total.add(camp, duration * 1e6);
+        if (round % PROFILE_DUMP_ROUND == 0 || round >= MAX_ROUND - 1) profile_dump();
+    }
 }
 
 #undef conductor
-#undef CACHE_BEGIN
-#undef CACHE_END
 #undef RD_NAMESPACE
 
@@ -0,0 +1,48 @@
+// Stand-in for the judge's console.h. Orders are recorded into PCommand and carried out by Game
+
+#ifndef RD_SIM_CONSOLE_H
+#define RD_SIM_CONSOLE_H
+
+#include "sdk.h"
+#include "filter.h"
+
+typedef void (*PathFunc)(const PMap &, Pos, Pos, const std::vector<Pos> &, std::vector<Pos> &);
+
+class Console
+{
+    const PMap &map;
+    const PPlayerInfo &info;
+    PCommand &cmd;
+    const PUnit *selected;
+    PathFunc pathFunc;
+
+    const PUnit *unit_of(const PUnit *u) const { return u ? u : selected; }
+    void order(POrder::Type type, const PUnit *unit, const PUnit *target, const Pos &pos, const char *name);
+
+public:
+    Console(const PMap &_map, const PPlayerInfo &_info, PCommand &_cmd);
+
+    int round() const { return info.round; }
+    int camp() const { return info.camp; }
+    int gold() const { return info.gold; }
+    int property() const { return info.property; }
+    int goldCostCurrentRound() const { return cmd.goldCost; }
+
+    void selectUnit(const PUnit *u) { selected = u; }
+    const PBuff *getBuff(const char *name, const PUnit *u = 0) const;
+    int unitArg(const char *name, const char *type, const PUnit *u = 0) const; // type: c(urrent), m(ax) or r(egen)
+
+    void changeShortestPathFunc(PathFunc f) { pathFunc = f; }
+    Pos randPosInArea(const Pos &center, int r2) const { return Circle(center, r2).randPosInArea(); }
+
+    void move(const Pos &p, const PUnit *u = 0);
+    void attack(const PUnit *target, const PUnit *u = 0);
+    void useSkill(const char *name, const PUnit *target, const PUnit *u = 0);
+    void useSkill(const char *name, const Pos &p, const PUnit *u = 0);
+    void chooseHero(const char *name);
+    void buyBackHero(const PUnit *u);
+    void buyHeroLevel(const PUnit *u);
+    void baseAttack(const PUnit *target);
+};
+
+#endif // RD_SIM_CONSOLE_H
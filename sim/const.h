@@ -0,0 +1,51 @@
+// Stand-in for the judge's const.h
+
+#ifndef RD_SIM_CONST_H
+#define RD_SIM_CONST_H
+
+#include "sdk.h"
+
+const int MAP_SIZE = 150;
+const int MAX_ROUND = 1000;
+
+const int MINE_NUM = 7;
+const int MINE_VOLUME = 2;
+const int MINING_RANGE = 25;
+// constant initialized, since Conductor reads them from a static constructor
+const Pos MINE_POS[MINE_NUM] = { Pos(75, 75), Pos(40, 110), Pos(110, 40), Pos(30, 65), Pos(120, 85), Pos(65, 30), Pos(85, 120) };
+
+const int MILITARY_BASE_NUM = 2;
+const int MILITARY_BASE_RANGE = 400;
+const int MILITARY_BASE_VIEW = 900;
+const Pos MILITARY_BASE_POS[MILITARY_BASE_NUM] = { Pos(12, 12), Pos(137, 137) };
+
+const int HAMMERGUARD_RANGE = 9;
+const int MASTER_RANGE = 49;
+const int BERSERKER_RANGE = 4;
+const int SCOUTER_RANGE = 36;
+const int Roshan_RANGE = 9;
+const int Dragon_RANGE = 16;
+
+const int MASTER_SPEED = 64;
+const int SCOUTER_VIEW = 225;
+const int CURE_RANGE = 64;
+
+const int HAMMERATTACK_MP = 20;
+const int HAMMERATTACK_RANGE = 36;
+const int BLINK_MP = 20;
+const int BLINK_RANGE = 100;
+const int SACRIFICE_MP = 20;
+const int SET_OBSERVER_MP = 20;
+const int SET_OBSERVER_RANGE = 49;
+
+const int NEW_HAMMERGUARD_COST = 100;
+const int NEW_MASTER_COST = 100;
+const int NEW_BERSERKER_COST = 100;
+const int NEW_SCOUTER_COST = 100;
+const int BUYBACK_COST_BASE = 20;
+const int BUYBACK_COST_PER_LEVEL = 10;
+const int LEVELUP_RANGE = 400;
+const int LEVELUP_COST_BASE = 30;
+const int LEVELUP_COST_PER_LEVEL = 20;
+
+#endif // RD_SIM_CONST_H
@@ -0,0 +1,28 @@
+// Stand-in for the judge's filter.h. Only the areas are used by myai.cpp
+
+#ifndef RD_SIM_FILTER_H
+#define RD_SIM_FILTER_H
+
+#include "sdk.h"
+
+class Area
+{
+public:
+    virtual ~Area() {}
+    virtual bool contain(const Pos &p) const = 0;
+    virtual Pos randPosInArea() const = 0;
+};
+
+class Circle : public Area
+{
+    Pos center;
+    int r2;
+
+public:
+    Circle(const Pos &_center, int _r2) : center(_center), r2(_r2) {}
+
+    bool contain(const Pos &p) const { return dis2(p, center) <= r2; }
+    Pos randPosInArea() const;
+};
+
+#endif // RD_SIM_FILTER_H
@@ -0,0 +1,459 @@
+// Simplified rules, close enough to exercise every branch of myai.cpp :
+// - both camps see their own units, mines, bases, and whatever is inside the view of their living units
+// - orders of both camps are carried out together : economy, skills, attacks, then moves, camp order alternating by round
+// - only the first order of a unit counts, dizzy or dead units ignore theirs
+// - damage is max(1, atk - def / 2), doubled on either side holding winordie
+// - a dead hero revives at its base after 10 + 2 * level rounds, other units are removed
+// - a hero within MINING_RANGE of a mine with energy mines 2 gold a round, unless an enemy hero is also there
+// - a camp loses when its base falls. after MAX_ROUND, base hp and then gold decide
+
+#include <algorithm>
+#include "game.h"
+
+/********************************/
+/*     Shared Helpers           */
+/********************************/
+
+std::mt19937 &sim_random()
+{
+    static std::mt19937 gen;
+    return gen;
+}
+
+void sim_blocks(const std::vector<PUnit> &units, int except, std::vector<Pos> &blocks)
+{
+    blocks.clear();
+    for (const PUnit &u : units)
+    {
+        if (u.id == except || u.hp < 1) continue;
+        if (u.isMine())
+        {
+            for (int i = - MINE_VOLUME + 1; i < MINE_VOLUME; i++)
+                for (int j = - MINE_VOLUME + 1; j < MINE_VOLUME; j++)
+                    blocks.push_back(Pos(u.pos.x + i, u.pos.y + j));
+        } else
+            blocks.push_back(u.pos);
+    }
+}
+
+const PUnit *sim_find(const std::vector<PUnit> &units, int id)
+{
+    auto i = std::lower_bound(units.begin(), units.end(), id, [](const PUnit &u, int _id) { return u.id < _id; });
+    return i != units.end() && i->id == id ? &*i : 0;
+}
+
+int hero_cost(const std::string &name, int owned)
+{
+    const std::string n(lowerCase(name));
+    int base(n == "hammerguard" ? NEW_HAMMERGUARD_COST : n == "master" ? NEW_MASTER_COST :
+             n == "berserker" ? NEW_BERSERKER_COST : NEW_SCOUTER_COST);
+    return base * (owned + 1);
+}
+
+/********************************/
+/*     Unit Types               */
+/********************************/
+
+struct UnitType
+{
+    const char *name;
+    int hp, mp, atk, def, speed, range, view;
+    int attackCd; // 0 means no attack
+    const char *skill; // 0 means none
+    int skillCd, skillMp;
+};
+
+const UnitType UNIT_TYPES[] =
+{
+    { "Hammerguard", 1500, 100, 50, 30, 36, HAMMERGUARD_RANGE, 100, 2, "hammerattack", 10, HAMMERATTACK_MP },
+    { "Master", 800, 150, 45, 10, MASTER_SPEED, MASTER_RANGE, 144, 2, "blink", 8, BLINK_MP },
+    { "Berserker", 1200, 80, 70, 20, 49, BERSERKER_RANGE, 100, 1, "sacrifice", 20, SACRIFICE_MP },
+    { "Scouter", 600, 120, 25, 10, 64, SCOUTER_RANGE, SCOUTER_VIEW, 2, "setobserver", 15, SET_OBSERVER_MP },
+    { "Observer", 1, 0, 0, 0, 0, 0, 100, 0, 0, 0, 0 },
+    { "MilitaryBase", 6000, 0, 60, 30, 0, MILITARY_BASE_RANGE, MILITARY_BASE_VIEW, 1, 0, 0, 0 },
+    { "Mine", 1000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { "Roshan", 2500, 0, 80, 40, 0, Roshan_RANGE, 64, 2, 0, 0, 0 },
+    { "Dragon", 1800, 0, 60, 30, 0, Dragon_RANGE, 81, 1, 0, 0, 0 }
+};
+
+const UnitType *unit_type(const std::string &name)
+{
+    for (const UnitType &t : UNIT_TYPES)
+        if (lowerCase(t.name) == lowerCase(name)) return &t;
+    return 0;
+}
+
+// writable views of the const lookups in PUnit
+PSkill *skill_of(PUnit &u, const char *name)
+{
+    for (PSkill &s : u.skills)
+        if (s.name == name) return &s;
+    return 0;
+}
+
+std::vector<int> &arg_of(PUnit &u, const char *name)
+{
+    for (PArg &a : u.args)
+        if (a.name == name) return a.val;
+    u.args.push_back(PArg{ name, std::vector<int>() });
+    return u.args.back().val;
+}
+
+const int INIT_GOLD = 200;
+const int INCOME = 2;
+const int MINE_GOLD = 2;
+const int MINE_REGEN_CAP = 300;
+const int OBSERVER_LIFE = 30;
+const int CURE_HP = 8;
+
+/********************************/
+/*     Game Implement           */
+/********************************/
+
+Game::Game(unsigned seed) : map(seed), round(0), nextId(0), cmds(2)
+{
+    sim_random().seed(seed);
+    gold[0] = gold[1] = INIT_GOLD;
+    for (int i=0; i<MILITARY_BASE_NUM; i++)
+        spawn("MilitaryBase", i, MILITARY_BASE_POS[i]);
+    for (int i=0; i<MINE_NUM; i++)
+    {
+        PUnit &m = spawn("Mine", 2, MINE_POS[i]);
+        m.args.push_back(PArg{ "energy", std::vector<int>(1, i ? 0 : MAX_ROUND * 2) });
+    }
+    spawn("Roshan", 2, Pos(50, 99));
+    spawn("Dragon", 2, Pos(99, 50));
+}
+
+PUnit *Game::find(int id)
+{
+    return const_cast<PUnit*>(sim_find(units, id));
+}
+
+PUnit &Game::spawn(const std::string &name, int camp, const Pos &p)
+{
+    const UnitType *t = unit_type(name);
+    PUnit u;
+    u.id = nextId++, u.camp = camp, u.name = t->name, u.level = 1;
+    u.hp = u.max_hp = t->hp, u.mp = u.max_mp = t->mp;
+    u.atk = t->atk, u.def = t->def, u.speed = t->speed, u.range = t->range, u.view = t->view;
+    u.pos = p;
+    if (t->attackCd) u.skills.push_back(PSkill{ "attack", 0, t->attackCd, 0 });
+    if (t->skill) u.skills.push_back(PSkill{ t->skill, 0, t->skillCd, t->skillMp });
+    u.args.push_back(PArg{ "lasthit", std::vector<int>() });
+    units.push_back(u); // ids only grow, so units stay sorted
+    return units.back();
+}
+
+Pos Game::free_pos_near(const Pos &p) const
+{
+    std::vector<Pos> blocks;
+    sim_blocks(units, -1, blocks);
+    for (int r=0; r<MAP_SIZE; r++)
+        for (int dx=-r; dx<=r; dx++)
+            for (int dy=-r; dy<=r; dy++)
+            {
+                if (std::max(std::abs(dx), std::abs(dy)) != r) continue;
+                Pos q(p.x + dx, p.y + dy);
+                if (q.x < 0 || q.y < 0 || q.x >= MAP_SIZE || q.y >= MAP_SIZE) continue;
+                if (std::find(blocks.begin(), blocks.end(), q) == blocks.end()) return q;
+            }
+    return p;
+}
+
+bool Game::acting(const PUnit &u) const
+{
+    return u.hp >= 1 && ! u.findBuff("reviving") && ! u.findBuff("dizzy");
+}
+
+int Game::base_hp(int camp) const
+{
+    for (const PUnit &u : units)
+        if (u.isBase() && u.camp == camp) return u.hp;
+    return 0;
+}
+
+void Game::add_buff(PUnit &u, const char *name, int time)
+{
+    for (PBuff &b : u.buffs)
+        if (b.name == name)
+        {
+            b.timeLeft = std::max(b.timeLeft, time);
+            return;
+        }
+    u.buffs.push_back(PBuff{ name, time });
+}
+
+void Game::hit(PUnit &from, PUnit &to, int damage)
+{
+    if (to.hp < 1 || to.isMine() || to.findBuff("reviving")) return;
+    if (from.findBuff("winordie")) damage *= 2;
+    if (to.findBuff("winordie")) damage *= 2;
+    to.hp -= std::max(1, damage);
+    add_buff(to, "beattacked", 1);
+    std::vector<int> &last = arg_of(to, "lasthit");
+    if ((int)last.size() <= from.id) last.resize(from.id + 1, -1);
+    last[from.id] = round;
+    if (to.hp < 1 && from.camp < 2)
+        gold[from.camp] += to.isHero() ? 40 + 10 * to.level : to.camp == 2 ? 150 : 5;
+}
+
+void Game::do_economy(int camp, const POrder &o)
+{
+    PUnit *u = o.unit < 0 ? 0 : find(o.unit);
+    if (o.type == POrder::CHOOSE_HERO)
+    {
+        const UnitType *t = unit_type(o.name);
+        if (! t || t->speed == 0 || ! t->attackCd) return; // only heroes move and fight
+        int owned(0);
+        for (const std::string &n : bought[camp])
+            if (lowerCase(n) == lowerCase(o.name)) owned++;
+        const int cost(hero_cost(o.name, owned));
+        if (cost > gold[camp]) return;
+        gold[camp] -= cost;
+        bought[camp].push_back(o.name);
+        spawn(o.name, camp, free_pos_near(MILITARY_BASE_POS[camp]));
+    }
+    else if (o.type == POrder::BUY_BACK)
+    {
+        if (! u || u->camp != camp || ! u->findBuff("reviving") || buyback_cost(*u) > gold[camp]) return;
+        gold[camp] -= buyback_cost(*u);
+        u->buffs.erase(std::remove_if(u->buffs.begin(), u->buffs.end(), [](const PBuff &b) { return b.name == "reviving"; }), u->buffs.end());
+        u->hp = u->max_hp, u->mp = u->max_mp, u->pos = free_pos_near(MILITARY_BASE_POS[camp]);
+    }
+    else if (o.type == POrder::BUY_LEVEL)
+    {
+        if (! u || u->camp != camp || ! u->isHero() || u->hp < 1) return;
+        if (dis2(u->pos, MILITARY_BASE_POS[camp]) > LEVELUP_RANGE || levelup_cost(*u) > gold[camp]) return;
+        gold[camp] -= levelup_cost(*u);
+        const int dHp(u->max_hp / 10);
+        u->level++, u->max_hp += dHp, u->hp += dHp, u->atk += u->atk / 10, u->def += u->def / 20;
+    }
+    else if (o.type == POrder::BASE_ATTACK)
+    {
+        PUnit *t = find(o.target);
+        for (PUnit &b : units)
+            if (b.isBase() && b.camp == camp && t && t->camp != camp && dis2(b.pos, t->pos) <= b.range)
+            {
+                PSkill *a = skill_of(b, "attack");
+                if (a->cd) return;
+                a->cd = a->maxCd;
+                hit(b, *t, b.atk - t->def / 2);
+            }
+    }
+}
+
+void Game::do_skill(PUnit &u, const POrder &o)
+{
+    PSkill *s = skill_of(u, o.name.c_str());
+    if (! s || s->name == "attack" || s->cd || u.mp < s->mp) return;
+    PUnit *t = o.target < 0 ? 0 : find(o.target);
+    if (s->name == "hammerattack")
+    {
+        if (! t || t->camp == u.camp || t->hp < 1 || dis2(u.pos, t->pos) > HAMMERATTACK_RANGE) return;
+        hit(u, *t, u.atk - t->def / 2);
+        add_buff(*t, "dizzy", 2);
+    }
+    else if (s->name == "sacrifice")
+    {
+        if (u.hp - 1 <= u.atk) return;
+        u.hp -= u.atk;
+        add_buff(u, "winordie", 5);
+    }
+    else if (s->name == "blink")
+    {
+        std::vector<Pos> blocks;
+        sim_blocks(units, u.id, blocks);
+        if (dis2(u.pos, o.pos) > BLINK_RANGE || o.pos.x < 0 || o.pos.y < 0 || o.pos.x >= MAP_SIZE || o.pos.y >= MAP_SIZE) return;
+        if (std::find(blocks.begin(), blocks.end(), o.pos) != blocks.end()) return;
+        u.pos = o.pos;
+    }
+    else if (s->name == "setobserver")
+    {
+        if (dis2(u.pos, o.pos) > SET_OBSERVER_RANGE || std::abs(map.getHeight(o.pos.x, o.pos.y) - map.getHeight(u.pos.x, u.pos.y)) > 1) return;
+        const int camp(u.camp);
+        const Pos p(o.pos);
+        s->cd = s->maxCd, u.mp -= s->mp; // spawn below may move u
+        PUnit &ob = spawn("Observer", camp, p);
+        ob.args.push_back(PArg{ "life", std::vector<int>(1, OBSERVER_LIFE) });
+        return;
+    }
+    s->cd = s->maxCd, u.mp -= s->mp;
+}
+
+void Game::do_attack(PUnit &u, const POrder &o)
+{
+    PSkill *a = skill_of(u, "attack");
+    PUnit *t = find(o.target);
+    if (! a || a->cd || ! t || t->camp == u.camp || t->hp < 1 || dis2(u.pos, t->pos) > u.range) return;
+    a->cd = a->maxCd;
+    hit(u, *t, u.atk - t->def / 2);
+}
+
+void Game::do_move(PUnit &u, const POrder &o)
+{
+    if (dis2(u.pos, o.pos) > u.speed || o.pos.x < 0 || o.pos.y < 0 || o.pos.x >= MAP_SIZE || o.pos.y >= MAP_SIZE) return;
+    std::vector<Pos> blocks;
+    sim_blocks(units, u.id, blocks);
+    if (std::find(blocks.begin(), blocks.end(), o.pos) == blocks.end())
+        u.pos = o.pos;
+}
+
+void Game::do_monsters()
+{
+    // a monster strikes back at whoever hit it last, if still in range
+    for (PUnit &m : units)
+    {
+        if (m.camp != 2 || m.isMine() || m.hp < 1) continue;
+        PSkill *a = skill_of(m, "attack");
+        const std::vector<int> &last = m["lasthit"]->val;
+        int target(-1), when(round - 5);
+        for (int id=0; id<(int)last.size(); id++)
+            if (last[id] > when)
+            {
+                const PUnit *t = sim_find(units, id);
+                if (t && t->hp >= 1 && dis2(t->pos, m.pos) <= m.range)
+                    target = id, when = last[id];
+            }
+        if (~target && ! a->cd)
+        {
+            a->cd = a->maxCd;
+            PUnit *t = find(target);
+            hit(m, *t, m.atk - t->def / 2);
+        }
+    }
+}
+
+void Game::do_mining()
+{
+    for (PUnit &m : units)
+    {
+        if (! m.isMine()) continue;
+        int &energy = arg_of(m, "energy")[0];
+        if (energy < MINE_REGEN_CAP) energy++;
+        std::vector<PUnit*> near[2];
+        for (PUnit &u : units)
+            if (u.camp < 2 && u.isHero() && u.hp >= 1 && ! u.findBuff("reviving") && dis2(u.pos, m.pos) <= MINING_RANGE)
+                near[u.camp].push_back(&u);
+        for (int c=0; c<2; c++)
+            if (! near[c].empty() && near[1-c].empty() && energy > 0)
+            {
+                const int got(std::min<int>(energy, MINE_GOLD * std::min<int>(near[c].size(), 3)));
+                gold[c] += got, energy -= got;
+                for (PUnit *u : near[c])
+                    add_buff(*u, "ismining", 1);
+            }
+    }
+}
+
+void Game::do_upkeep()
+{
+    for (PUnit &u : units)
+    {
+        for (PSkill &s : u.skills)
+            if (s.cd) s.cd--;
+        bool revived(false);
+        for (PBuff &b : u.buffs)
+            if (--b.timeLeft < 0 && b.name == "reviving") revived = true;
+        u.buffs.erase(std::remove_if(u.buffs.begin(), u.buffs.end(), [](const PBuff &b) { return b.timeLeft < 0; }), u.buffs.end());
+        if (revived)
+            u.hp = u.max_hp, u.mp = u.max_mp, u.pos = free_pos_near(MILITARY_BASE_POS[u.camp]);
+        if (u.isHero() && u.hp >= 1 && ! u.findBuff("reviving"))
+            u.hp = std::min(u.max_hp, u.hp + 1), u.mp = std::min(u.max_mp, u.mp + 2);
+        if (u.name == "Observer")
+            arg_of(u, "life")[0]--;
+    }
+    for (const PUnit &m : units)
+        if (m.name == "Master" && m.hp >= 1 && ! m.findBuff("reviving"))
+            for (PUnit &u : units)
+                if (u.camp == m.camp && u.isHero() && u.hp >= 1 && dis2(u.pos, m.pos) <= CURE_RANGE)
+                    u.hp = std::min(u.max_hp, u.hp + CURE_HP);
+
+    for (PUnit &u : units)
+        if (u.isHero() && u.hp < 1 && ! u.findBuff("reviving"))
+        {
+            u.hp = 0;
+            u.buffs.clear();
+            add_buff(u, "reviving", 10 + 2 * u.level);
+        }
+    units.erase(std::remove_if(units.begin(), units.end(), [](const PUnit &u)
+    {
+        if (u.isHero() || u.isBase() || u.isMine()) return false;
+        return u.hp < 1 || (u.name == "Observer" && u["life"]->val[0] <= 0);
+    }), units.end());
+}
+
+void Game::make_info(int camp, PPlayerInfo &info) const
+{
+    info.round = round, info.camp = camp, info.gold = gold[camp];
+    info.property = gold[camp];
+    info.units.clear();
+    for (const PUnit &u : units)
+    {
+        bool seen(u.camp == camp || u.isMine() || u.isBase());
+        if (u.camp == camp && u.isHero())
+            info.property += hero_cost(u.name, 0) + (u.level - 1) * LEVELUP_COST_BASE;
+        if (! seen && ! u.findBuff("reviving"))
+            for (const PUnit &v : units)
+                if (v.camp == camp && v.hp >= 1 && ! v.findBuff("reviving") && dis2(u.pos, v.pos) <= v.view)
+                {
+                    seen = true;
+                    break;
+                }
+        if (seen) info.units.push_back(u);
+    }
+}
+
+void Game::step()
+{
+    const int first(round & 1);
+    for (int k=0; k<2; k++)
+    {
+        const int c(first ^ k);
+        for (const POrder &o : cmds[c].orders)
+            if (o.type == POrder::CHOOSE_HERO || o.type == POrder::BUY_BACK || o.type == POrder::BUY_LEVEL || o.type == POrder::BASE_ATTACK)
+                do_economy(c, o);
+    }
+
+    // the first order of each unit, grouped by stage. ids are kept since skills may add units
+    std::vector<std::pair<int, POrder> > stage[3]; // skills, attacks, moves
+    for (int k=0; k<2; k++)
+    {
+        const int c(first ^ k);
+        std::vector<int> done;
+        for (const POrder &o : cmds[c].orders)
+        {
+            if (o.type != POrder::MOVE && o.type != POrder::ATTACK && o.type != POrder::SKILL_UNIT && o.type != POrder::SKILL_POS) continue;
+            const PUnit *u = sim_find(units, o.unit);
+            if (! u || u->camp != c || std::count(done.begin(), done.end(), o.unit)) continue;
+            done.push_back(o.unit);
+            stage[o.type == POrder::MOVE ? 2 : o.type == POrder::ATTACK ? 1 : 0].push_back(std::make_pair(o.unit, o));
+        }
+    }
+    for (int s=0; s<3; s++)
+        for (const auto &i : stage[s])
+        {
+            PUnit *u = find(i.first);
+            if (! u || ! acting(*u)) continue;
+            if (s == 0) do_skill(*u, i.second);
+            else if (s == 1) do_attack(*u, i.second);
+            else do_move(*u, i.second);
+        }
+
+    do_monsters();
+    do_mining();
+    do_upkeep();
+    gold[0] += INCOME, gold[1] += INCOME;
+    cmds[0] = cmds[1] = PCommand();
+    round++;
+}
+
+int Game::winner() const
+{
+    const int hp0(base_hp(0)), hp1(base_hp(1));
+    if (hp0 < 1 || hp1 < 1)
+        return hp0 < 1 && hp1 < 1 ? 2 : hp0 < 1 ? 1 : 0;
+    if (round < MAX_ROUND) return -1;
+    if (hp0 != hp1) return hp0 > hp1 ? 0 : 1;
+    return gold[0] == gold[1] ? 2 : gold[0] > gold[1] ? 0 : 1;
+}
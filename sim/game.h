@@ -0,0 +1,71 @@
+// Headless stand-in for the judge's game engine. The rules are simplified, see game.cpp
+
+#ifndef RD_SIM_GAME_H
+#define RD_SIM_GAME_H
+
+#include <random>
+#include "sdk.h"
+#include "const.h"
+
+/********************************/
+/*     Shared Helpers           */
+/********************************/
+
+std::mt19937 &sim_random(); // seeded once by Game
+
+// cells a moving unit may not enter : other living units, and the whole volume of each mine
+void sim_blocks(const std::vector<PUnit> &units, int except, std::vector<Pos> &blocks);
+
+// the unit with this id in an id-sorted list, 0 if none
+const PUnit *sim_find(const std::vector<PUnit> &units, int id);
+
+int hero_cost(const std::string &name, int owned);
+inline int buyback_cost(const PUnit &u) { return BUYBACK_COST_PER_LEVEL * u.level + BUYBACK_COST_BASE; }
+inline int levelup_cost(const PUnit &u) { return LEVELUP_COST_PER_LEVEL * u.level + LEVELUP_COST_BASE; }
+
+/********************************/
+/*     Game                     */
+/********************************/
+
+class Game
+{
+    PMap map;
+    int round;
+    int nextId;
+    int gold[2];
+    std::vector<PUnit> units; // sorted by id
+    std::vector<PCommand> cmds; // by camp, for the current round
+    std::vector<std::string> bought[2]; // hero names in buying order
+
+    PUnit *find(int id);
+    PUnit &spawn(const std::string &name, int camp, const Pos &p);
+    Pos free_pos_near(const Pos &p) const;
+    bool acting(const PUnit &u) const; // alive, not reviving and not dizzy
+
+    void add_buff(PUnit &u, const char *name, int time);
+    void hit(PUnit &from, PUnit &to, int damage);
+
+    void do_economy(int camp, const POrder &o);
+    void do_skill(PUnit &u, const POrder &o);
+    void do_attack(PUnit &u, const POrder &o);
+    void do_move(PUnit &u, const POrder &o);
+    void do_monsters();
+    void do_mining();
+    void do_upkeep(); // cd, buffs, regen, death and revive
+
+public:
+    explicit Game(unsigned seed);
+
+    const PMap &get_map() const { return map; }
+    int get_round() const { return round; }
+    int get_gold(int camp) const { return gold[camp]; }
+    int base_hp(int camp) const;
+
+    void make_info(int camp, PPlayerInfo &info) const; // what the camp sees this round
+    void set_command(int camp, const PCommand &cmd) { cmds[camp] = cmd; }
+    void step(); // carry out both commands and advance a round
+
+    int winner() const; // -1 while running, 2 for a draw
+};
+
+#endif // RD_SIM_GAME_H
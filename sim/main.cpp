@@ -0,0 +1,81 @@
+// Headless match of player_ai against itself, for latency measurement and regression runs off the judge.
+// sdk.h, const.h, filter.h and console.h here are stand-ins for the judge's, with the same names and
+// just what myai.cpp uses. The rules in game.cpp are simplified, so results say nothing about real strength
+//
+// Build (from the repository root, MY_RAND_SEED seeds both the map and myai.cpp.
+// NDEBUG keeps the 100ms assert in player_ai from ending the match on a slow round) :
+//   g++ -std=c++11 -O2 -DNDEBUG -DMY_RAND_SEED=1 -Isim -o simulate myai.cpp sim/sdk.cpp sim/game.cpp sim/main.cpp
+// Usage :
+//   ./simulate [max_rounds] [timing.csv]
+// Conductor keeps its state in statics, so run one match per process
+
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "sdk.h"
+#include "const.h"
+#include "game.h"
+
+#ifndef MY_RAND_SEED
+#define MY_RAND_SEED 1
+#endif // MY_RAND_SEED
+
+void player_ai(const PMap &map, const PPlayerInfo &info, PCommand &cmd);
+
+// milliseconds, sorted in place
+void print_latency(int camp, std::vector<double> &t)
+{
+    if (t.empty()) return;
+    std::sort(t.begin(), t.end());
+    double sum(0);
+    for (double x : t) sum += x;
+    auto at = [&](double q) { return t[std::min(t.size() - 1, (size_t)(q * t.size()))]; };
+    std::cout << "camp " << camp << " : rounds " << t.size() << ", mean " << sum / t.size() << "ms"
+              << ", p50 " << at(0.5) << "ms, p99 " << at(0.99) << "ms, max " << t.back() << "ms"
+              << ", over 100ms " << std::count_if(t.begin(), t.end(), [](double x) { return x > 100; }) << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    const int maxRound(argc > 1 ? atoi(argv[1]) : MAX_ROUND);
+    std::ofstream csv;
+    if (argc > 2)
+    {
+        csv.open(argv[2]);
+        csv << "round,camp,ms,orders,gold\n";
+    }
+
+    Game game(MY_RAND_SEED);
+    std::vector<double> latency[2];
+    PPlayerInfo info;
+    PCommand cmd;
+    while (game.winner() == -1 && game.get_round() < maxRound)
+    {
+        for (int camp=0; camp<2; camp++)
+        {
+            game.make_info(camp, info);
+            auto start = std::chrono::steady_clock::now();
+            player_ai(game.get_map(), info, cmd);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            latency[camp].push_back(ms);
+            if (csv.is_open())
+                csv << info.round << ',' << camp << ',' << ms << ',' << cmd.orders.size() << ',' << info.gold << '\n';
+            game.set_command(camp, cmd);
+        }
+        game.step();
+    }
+
+    std::cout << "seed " << MY_RAND_SEED << ", rounds " << game.get_round() << ", winner " << game.winner() << std::endl;
+    for (int camp=0; camp<2; camp++)
+    {
+        std::cout << "camp " << camp << " : base hp " << game.base_hp(camp) << ", gold " << game.get_gold(camp) << std::endl;
+        print_latency(camp, latency[camp]);
+    }
+    // the static Conductors would release mines through console, which is gone by then
+    std::cout.flush();
+    csv.close();
+    std::_Exit(0);
+}
@@ -0,0 +1,257 @@
+// Stand-in SDK : units, map, pathfinding and Console
+
+#include <queue>
+#include <cctype>
+#include <algorithm>
+#include <functional>
+#include "sdk.h"
+#include "const.h"
+#include "filter.h"
+#include "console.h"
+#include "game.h"
+
+/********************************/
+/*     Units                    */
+/********************************/
+
+const PBuff *PUnit::findBuff(const std::string &name) const
+{
+    for (const PBuff &b : buffs)
+        if (b.name == name) return &b;
+    return 0;
+}
+
+const PSkill *PUnit::findSkill(const std::string &name) const
+{
+    for (const PSkill &s : skills)
+        if (s.name == name) return &s;
+    return 0;
+}
+
+const PArg *PUnit::operator[](const std::string &name) const
+{
+    for (const PArg &a : args)
+        if (a.name == name) return &a;
+    return 0;
+}
+
+bool PUnit::isHero() const
+{
+    return name == "Hammerguard" || name == "Master" || name == "Berserker" || name == "Scouter";
+}
+
+bool PUnit::isBase() const { return name == "MilitaryBase"; }
+bool PUnit::isMine() const { return name == "Mine"; }
+
+std::string lowerCase(std::string s)
+{
+    for (char &c : s)
+        c = tolower(c);
+    return s;
+}
+
+/********************************/
+/*     Map                      */
+/********************************/
+
+PMap::PMap() : height(MAP_SIZE * MAP_SIZE, 0) {}
+
+PMap::PMap(unsigned seed) : height(MAP_SIZE * MAP_SIZE)
+{
+    // smooth hills, so neighbouring cells differ by at most 1 and every cell stays reachable.
+    // mirrored through the center, so both camps get the same map
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> phase(0, 6.2832);
+    const double a(phase(gen)), b(phase(gen));
+    for (int x=0; x<MAP_SIZE; x++)
+        for (int y=0; y<MAP_SIZE; y++)
+        {
+            const double v(sin(x / 11.0 + a) * cos(y / 13.0 + b) + sin((MAP_SIZE - 1 - x) / 11.0 + a) * cos((MAP_SIZE - 1 - y) / 13.0 + b));
+            height[x * MAP_SIZE + y] = (int) floor(2 + v * 0.9);
+        }
+}
+
+int PMap::getHeight(int x, int y) const
+{
+    x = std::min(std::max(x, 0), MAP_SIZE - 1), y = std::min(std::max(y, 0), MAP_SIZE - 1);
+    return height[x * MAP_SIZE + y];
+}
+
+void findShortestPath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &path)
+{
+    // stamped buffers, since Console::move runs this for every order and its time counts into player_ai
+    static std::vector<int> blockStamp(MAP_SIZE * MAP_SIZE), seenStamp(MAP_SIZE * MAP_SIZE), closeStamp(MAP_SIZE * MAP_SIZE), from(MAP_SIZE * MAP_SIZE);
+    static std::vector<double> g(MAP_SIZE * MAP_SIZE);
+    static int stamp = 0;
+    stamp++;
+
+    auto inside = [](const Pos &p) { return p.x >= 0 && p.y >= 0 && p.x < MAP_SIZE && p.y < MAP_SIZE; };
+    auto h = [&](const Pos &p)
+    {
+        int dx(std::abs(p.x - dest.x)), dy(std::abs(p.y - dest.y));
+        return std::max(dx, dy) + (sqrt(2.0) - 1) * std::min(dx, dy);
+    };
+    // the closest in-map cell to dest is as close as a path gets. clamped before h, whose abs would overflow on a far off one
+    dest = Pos(std::min(std::max(dest.x, 0), MAP_SIZE - 1), std::min(std::max(dest.y, 0), MAP_SIZE - 1));
+    path.clear();
+    if (! inside(start))
+    {
+        path.push_back(start);
+        return;
+    }
+    for (const Pos &p : blocks)
+        if (inside(p))
+            blockStamp[p.x * MAP_SIZE + p.y] = stamp;
+    auto passable = [&](const Pos &p) { return inside(p) && blockStamp[p.x * MAP_SIZE + p.y] != stamp; };
+
+    std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int> >, std::greater<std::pair<double, int> > > open;
+    const int s(start.x * MAP_SIZE + start.y);
+    int best(s);
+    double bestH(h(start));
+    g[s] = 0, from[s] = -1, seenStamp[s] = stamp;
+    open.push(std::make_pair(bestH, s));
+    while (! open.empty())
+    {
+        const int c = open.top().second;
+        open.pop();
+        if (closeStamp[c] == stamp) continue;
+        closeStamp[c] = stamp;
+        const Pos p(c / MAP_SIZE, c % MAP_SIZE);
+        if (h(p) < bestH)
+            best = c, bestH = h(p);
+        if (p == dest) break;
+        for (int dx=-1; dx<=1; dx++)
+            for (int dy=-1; dy<=1; dy++)
+            {
+                const Pos q(p.x + dx, p.y + dy);
+                if ((! dx && ! dy) || ! passable(q)) continue;
+                if (dx && dy && (! passable(Pos(p.x + dx, p.y)) || ! passable(Pos(p.x, p.y + dy)))) continue;
+                if (std::abs(map.getHeight(q.x, q.y) - map.getHeight(p.x, p.y)) > 1) continue;
+                const int qc(q.x * MAP_SIZE + q.y);
+                const double cost(g[c] + (dx && dy ? sqrt(2.0) : 1.0));
+                if (closeStamp[qc] == stamp || (seenStamp[qc] == stamp && g[qc] <= cost)) continue;
+                g[qc] = cost, from[qc] = c, seenStamp[qc] = stamp;
+                open.push(std::make_pair(cost + h(q), qc));
+            }
+    }
+    for (int c=best; ~c; c=from[c])
+        path.push_back(Pos(c / MAP_SIZE, c % MAP_SIZE));
+    std::reverse(path.begin(), path.end());
+}
+
+Pos Circle::randPosInArea() const
+{
+    const int r((int) sqrt((double) r2));
+    std::uniform_int_distribution<int> d(-r, r);
+    while (true)
+    {
+        Pos p(center.x + d(sim_random()), center.y + d(sim_random()));
+        if (contain(p)) return p;
+    }
+}
+
+/********************************/
+/*     Console                  */
+/********************************/
+
+Console::Console(const PMap &_map, const PPlayerInfo &_info, PCommand &_cmd)
+    : map(_map), info(_info), cmd(_cmd), selected(0), pathFunc(findShortestPath)
+{
+    cmd.orders.clear();
+    cmd.goldCost = 0;
+}
+
+const PBuff *Console::getBuff(const char *name, const PUnit *u) const
+{
+    u = unit_of(u);
+    return u ? u->findBuff(name) : 0;
+}
+
+int Console::unitArg(const char *name, const char *type, const PUnit *u) const
+{
+    u = unit_of(u);
+    if (! u) return 0;
+    const std::string n(name), t(type);
+    if (n == "hp") return t == "m" ? u->max_hp : t == "r" ? (u->isHero() ? 1 : 0) : u->hp;
+    if (n == "mp") return t == "m" ? u->max_mp : t == "r" ? (u->isHero() ? 2 : 0) : u->mp;
+    if (n == "atk") return u->atk;
+    if (n == "def") return u->def;
+    if (n == "speed") return u->speed;
+    if (n == "range") return u->range;
+    if (n == "view") return u->view;
+    if (n == "level") return u->level;
+    const PArg *a = (*u)[n];
+    return a && ! a->val.empty() ? a->val[0] : 0;
+}
+
+void Console::order(POrder::Type type, const PUnit *unit, const PUnit *target, const Pos &pos, const char *name)
+{
+    POrder o;
+    o.type = type;
+    o.unit = unit ? unit->id : -1;
+    o.target = target ? target->id : -1;
+    o.pos = pos;
+    o.name = name ? name : "";
+    cmd.orders.push_back(o);
+}
+
+void Console::move(const Pos &p, const PUnit *u)
+{
+    // the path is found now, with the function chosen by changeShortestPathFunc, and the unit
+    // goes as far along it as its speed allows
+    u = unit_of(u);
+    if (! u) return;
+    std::vector<Pos> blocks, path;
+    sim_blocks(info.units, u->id, blocks);
+    pathFunc(map, u->pos, p, blocks, path);
+    Pos to(u->pos);
+    for (const Pos &q : path)
+    {
+        if (dis2(q, u->pos) > u->speed) break;
+        to = q;
+    }
+    order(POrder::MOVE, u, 0, to, 0);
+}
+
+void Console::attack(const PUnit *target, const PUnit *u)
+{
+    order(POrder::ATTACK, unit_of(u), target, Pos(-1, -1), 0);
+}
+
+void Console::useSkill(const char *name, const PUnit *target, const PUnit *u)
+{
+    order(POrder::SKILL_UNIT, unit_of(u), target, Pos(-1, -1), name);
+}
+
+void Console::useSkill(const char *name, const Pos &p, const PUnit *u)
+{
+    order(POrder::SKILL_POS, unit_of(u), 0, p, name);
+}
+
+void Console::chooseHero(const char *name)
+{
+    int owned(0);
+    for (const POrder &o : cmd.orders)
+        if (o.type == POrder::CHOOSE_HERO && lowerCase(o.name) == lowerCase(name)) owned++;
+    for (const PUnit &u : info.units)
+        if (u.camp == info.camp && lowerCase(u.name) == lowerCase(name)) owned++;
+    cmd.goldCost += hero_cost(name, owned);
+    order(POrder::CHOOSE_HERO, 0, 0, Pos(-1, -1), name);
+}
+
+void Console::buyBackHero(const PUnit *u)
+{
+    cmd.goldCost += buyback_cost(*u);
+    order(POrder::BUY_BACK, u, 0, Pos(-1, -1), 0);
+}
+
+void Console::buyHeroLevel(const PUnit *u)
+{
+    cmd.goldCost += levelup_cost(*u);
+    order(POrder::BUY_LEVEL, u, 0, Pos(-1, -1), 0);
+}
+
+void Console::baseAttack(const PUnit *target)
+{
+    order(POrder::BASE_ATTACK, 0, target, Pos(-1, -1), 0);
+}
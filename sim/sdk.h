@@ -0,0 +1,117 @@
+// Stand-in for the judge's sdk.h. Only what myai.cpp uses is provided, see main.cpp
+
+#ifndef RD_SIM_SDK_H
+#define RD_SIM_SDK_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <ostream>
+
+/********************************/
+/*     Geometry                 */
+/********************************/
+
+// +=, -=, *= and scaling are defined by myai.cpp itself, so they must not appear here
+struct Pos
+{
+    int x, y;
+    constexpr Pos() : x(0), y(0) {}
+    constexpr Pos(int _x, int _y) : x(_x), y(_y) {}
+};
+
+inline bool operator==(const Pos &a, const Pos &b) { return a.x == b.x && a.y == b.y; }
+inline bool operator!=(const Pos &a, const Pos &b) { return ! (a == b); }
+inline Pos operator+(const Pos &a, const Pos &b) { return Pos(a.x + b.x, a.y + b.y); }
+inline Pos operator-(const Pos &a, const Pos &b) { return Pos(a.x - b.x, a.y - b.y); }
+inline std::ostream &operator<<(std::ostream &os, const Pos &p) { return os << "(" << p.x << "," << p.y << ")"; }
+
+inline int dis2(const Pos &a, const Pos &b) { return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y); }
+inline double dis(const Pos &a, const Pos &b) { return sqrt((double)dis2(a, b)); }
+
+/********************************/
+/*     Units                    */
+/********************************/
+
+struct PBuff
+{
+    std::string name;
+    int timeLeft;
+};
+
+struct PSkill
+{
+    std::string name;
+    int cd, maxCd, mp;
+};
+
+struct PArg
+{
+    std::string name;
+    std::vector<int> val;
+};
+
+struct PUnit
+{
+    int id, camp; // camp 2 is neutral (mines and monsters)
+    std::string name;
+    int level, hp, max_hp, mp, max_mp, atk, def, speed, range, view;
+    Pos pos;
+    std::vector<PBuff> buffs;
+    std::vector<PSkill> skills;
+    std::vector<PArg> args;
+
+    const PBuff *findBuff(const std::string &name) const;
+    const PSkill *findSkill(const std::string &name) const;
+    const PArg *operator[](const std::string &name) const;
+
+    bool isHero() const;
+    bool isBase() const;
+    bool isMine() const;
+};
+
+/********************************/
+/*     Round Interface          */
+/********************************/
+
+class PMap
+{
+    std::vector<int> height;
+
+public:
+    PMap();
+    explicit PMap(unsigned seed);
+
+    int getHeight(int x, int y) const;
+};
+
+struct PPlayerInfo
+{
+    int round, camp, gold, property;
+    std::vector<PUnit> units; // sorted by id
+};
+
+struct POrder
+{
+    enum Type { MOVE, ATTACK, SKILL_UNIT, SKILL_POS, CHOOSE_HERO, BUY_BACK, BUY_LEVEL, BASE_ATTACK };
+    Type type;
+    int unit, target; // ids, -1 if none
+    Pos pos;
+    std::string name; // skill or hero
+};
+
+struct PCommand
+{
+    std::vector<POrder> orders;
+    int goldCost; // gold spent by the orders above
+
+    PCommand() : goldCost(0) {}
+};
+
+std::string lowerCase(std::string s);
+
+// A* on 8-neighbour grid. a step needs the heights to differ by at most 1.
+// path goes from start to the reachable cell nearest to dest, both included
+void findShortestPath(const PMap &map, Pos start, Pos dest, const std::vector<Pos> &blocks, std::vector<Pos> &path);
+
+#endif // RD_SIM_SDK_H
@@ -0,0 +1,266 @@
+// Converts the binary trace written by myai.cpp (-DRD_TRACE_FILE) to CSV or JSON
+// Build : g++ -std=c++11 -O2 -o trace_reader trace_reader.cpp
+// Usage : trace_reader trace_ver10.bin csv <out_prefix>   -> <out_prefix>_{rounds,units,egroups,fgroups,actions}.csv
+//         trace_reader trace_ver10.bin json               -> one JSON object per record on stdout
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+/********************************/
+/*     Layout                   */
+/********************************/
+
+// copied from the Tracer section of myai.cpp. KEEP THEM IN SYNC
+
+const uint32_t TRACE_VERSION = 1;
+
+enum TraceType
+{
+    TRACE_ROUND = 1,
+    TRACE_UNIT,
+    TRACE_E_GROUP,
+    TRACE_F_GROUP,
+    TRACE_ACTION,
+    TRACE_TIME
+};
+
+const char *BRANCH_NAME[] = { "none", "goback", "attack_base", "protect_base", "scout", "mine", "support", "attack", "search", "fallback", "planned" };
+const int BRANCH_NUM = sizeof BRANCH_NAME / sizeof BRANCH_NAME[0];
+
+const char *KIND_NAME[] = { "other", "hammerguard", "master", "berserker", "scouter", "observer", "mine", "militarybase", "roshan", "dragon" };
+const int KIND_NUM = sizeof KIND_NAME / sizeof KIND_NAME[0];
+
+#pragma pack(push, 1)
+struct TraceRound { int32_t round, camp, gold; };
+struct TraceUnit { int32_t id, camp, kind, level, hp, mp, x, y; };
+struct TraceEGroup { int32_t groupId, kindMask, memberCnt; float danger, value, mine; };
+struct TraceFGroup { int32_t groupId, kindMask, memberCnt; float ability, health, surround; };
+struct TraceAction { int32_t groupId, branch, x, y; };
+struct TraceTime { float seconds; };
+#pragma pack(pop)
+
+/********************************/
+/*     Output                   */
+/********************************/
+
+// Receives every record with the round it belongs to
+class Writer
+{
+public:
+    virtual ~Writer() {}
+    virtual void round(const TraceRound &r) = 0;
+    virtual void unit(const TraceRound &r, const TraceUnit &u) = 0;
+    virtual void e_group(const TraceRound &r, const TraceEGroup &g, const int32_t *ids) = 0;
+    virtual void f_group(const TraceRound &r, const TraceFGroup &g, const int32_t *ids) = 0;
+    virtual void action(const TraceRound &r, const TraceAction &a) = 0;
+    virtual void time(const TraceRound &r, const TraceTime &t) = 0;
+};
+
+const char *kind_name(int k) { return k >= 0 && k < KIND_NUM ? KIND_NAME[k] : "?"; }
+const char *branch_name(int b) { return b >= 0 && b < BRANCH_NUM ? BRANCH_NAME[b] : "?"; }
+
+std::string id_list(const int32_t *ids, int n, const char *sep)
+{
+    std::string ret;
+    for (int i=0; i<n; i++)
+    {
+        if (i) ret += sep;
+        ret += std::to_string(ids[i]);
+    }
+    return ret;
+}
+
+class CsvWriter : public Writer
+{
+    std::ofstream rounds, units, eGroups, fGroups, actions;
+
+public:
+    CsvWriter(const std::string &prefix)
+        : rounds(prefix + "_rounds.csv"), units(prefix + "_units.csv"), eGroups(prefix + "_egroups.csv"),
+          fGroups(prefix + "_fgroups.csv"), actions(prefix + "_actions.csv")
+    {
+        rounds << "round,camp,gold,seconds\n";
+        units << "round,camp,id,unit_camp,kind,level,hp,mp,x,y\n";
+        eGroups << "round,camp,group,kind_mask,members,danger,value,mine\n";
+        fGroups << "round,camp,group,kind_mask,members,ability,health,surround\n";
+        actions << "round,camp,group,branch,x,y\n";
+    }
+
+    // the time record closes a round, so rounds.csv is written there
+    void round(const TraceRound &) {}
+
+    void unit(const TraceRound &r, const TraceUnit &u)
+    {
+        units << r.round << ',' << r.camp << ',' << u.id << ',' << u.camp << ',' << kind_name(u.kind) << ','
+              << u.level << ',' << u.hp << ',' << u.mp << ',' << u.x << ',' << u.y << '\n';
+    }
+
+    void e_group(const TraceRound &r, const TraceEGroup &g, const int32_t *ids)
+    {
+        eGroups << r.round << ',' << r.camp << ',' << g.groupId << ',' << g.kindMask << ",\"" << id_list(ids, g.memberCnt, " ") << "\","
+                << g.danger << ',' << g.value << ',' << g.mine << '\n';
+    }
+
+    void f_group(const TraceRound &r, const TraceFGroup &g, const int32_t *ids)
+    {
+        fGroups << r.round << ',' << r.camp << ',' << g.groupId << ',' << g.kindMask << ",\"" << id_list(ids, g.memberCnt, " ") << "\","
+                << g.ability << ',' << g.health << ',' << g.surround << '\n';
+    }
+
+    void action(const TraceRound &r, const TraceAction &a)
+    {
+        actions << r.round << ',' << r.camp << ',' << a.groupId << ',' << branch_name(a.branch) << ',' << a.x << ',' << a.y << '\n';
+    }
+
+    void time(const TraceRound &r, const TraceTime &t)
+    {
+        rounds << r.round << ',' << r.camp << ',' << r.gold << ',' << t.seconds << '\n';
+    }
+};
+
+class JsonWriter : public Writer
+{
+    std::ostream &os;
+
+    // factors may be inf or nan (e.g. surround_factor with no enemy around), which JSON cannot hold
+    static std::string num(float f) { return std::isfinite(f) ? std::to_string(f) : "null"; }
+
+    std::ostream &head(const char *type, const TraceRound &r)
+    {
+        return os << "{\"type\":\"" << type << "\",\"round\":" << r.round << ",\"camp\":" << r.camp;
+    }
+
+public:
+    JsonWriter(std::ostream &_os) : os(_os) {}
+
+    void round(const TraceRound &r) { head("round", r) << ",\"gold\":" << r.gold << "}\n"; }
+
+    void unit(const TraceRound &r, const TraceUnit &u)
+    {
+        head("unit", r) << ",\"id\":" << u.id << ",\"unit_camp\":" << u.camp << ",\"kind\":\"" << kind_name(u.kind)
+                        << "\",\"level\":" << u.level << ",\"hp\":" << u.hp << ",\"mp\":" << u.mp
+                        << ",\"x\":" << u.x << ",\"y\":" << u.y << "}\n";
+    }
+
+    void e_group(const TraceRound &r, const TraceEGroup &g, const int32_t *ids)
+    {
+        head("egroup", r) << ",\"group\":" << g.groupId << ",\"kind_mask\":" << g.kindMask
+                          << ",\"members\":[" << id_list(ids, g.memberCnt, ",") << "],\"danger\":" << num(g.danger)
+                          << ",\"value\":" << num(g.value) << ",\"mine\":" << num(g.mine) << "}\n";
+    }
+
+    void f_group(const TraceRound &r, const TraceFGroup &g, const int32_t *ids)
+    {
+        head("fgroup", r) << ",\"group\":" << g.groupId << ",\"kind_mask\":" << g.kindMask
+                          << ",\"members\":[" << id_list(ids, g.memberCnt, ",") << "],\"ability\":" << num(g.ability)
+                          << ",\"health\":" << num(g.health) << ",\"surround\":" << num(g.surround) << "}\n";
+    }
+
+    void action(const TraceRound &r, const TraceAction &a)
+    {
+        head("action", r) << ",\"group\":" << a.groupId << ",\"branch\":\"" << branch_name(a.branch)
+                          << "\",\"x\":" << a.x << ",\"y\":" << a.y << "}\n";
+    }
+
+    void time(const TraceRound &r, const TraceTime &t) { head("time", r) << ",\"seconds\":" << num(t.seconds) << "}\n"; }
+};
+
+/********************************/
+/*     Reader                   */
+/********************************/
+
+// returns false on a malformed file. unknown record types are skipped
+bool read_trace(std::istream &is, Writer &w)
+{
+    char magic[4];
+    uint32_t version;
+    if (! is.read(magic, 4) || memcmp(magic, "RDTR", 4) != 0 || ! is.read((char*) &version, sizeof version))
+    {
+        std::cerr << "not a trace file" << std::endl;
+        return false;
+    }
+    if (version != TRACE_VERSION)
+    {
+        std::cerr << "trace version " << version << ", expected " << TRACE_VERSION << std::endl;
+        return false;
+    }
+
+    TraceRound cur = { -1, -1, 0 };
+    std::vector<char> buf;
+    uint16_t head[2];
+    while (is.read((char*) head, sizeof head))
+    {
+        buf.resize(head[1]);
+        if (head[1] && ! is.read(buf.data(), head[1]))
+        {
+            std::cerr << "truncated record" << std::endl;
+            return false;
+        }
+        const char *p = buf.data();
+
+        // fixed part, then the trailing member ids of group records
+        #define RD_PAYLOAD(T, var) if (head[1] < sizeof(T)) { std::cerr << "short record" << std::endl; return false; } T var; memcpy(&var, p, sizeof(T))
+        switch (head[0])
+        {
+        case TRACE_ROUND: { RD_PAYLOAD(TraceRound, r); cur = r; w.round(r); break; }
+        case TRACE_UNIT: { RD_PAYLOAD(TraceUnit, u); w.unit(cur, u); break; }
+        case TRACE_E_GROUP:
+        {
+            RD_PAYLOAD(TraceEGroup, g);
+            std::vector<int32_t> ids(g.memberCnt);
+            if (head[1] != sizeof g + ids.size() * sizeof(int32_t)) { std::cerr << "bad group record" << std::endl; return false; }
+            if (! ids.empty()) memcpy(ids.data(), p + sizeof g, ids.size() * sizeof(int32_t));
+            w.e_group(cur, g, ids.data());
+            break;
+        }
+        case TRACE_F_GROUP:
+        {
+            RD_PAYLOAD(TraceFGroup, g);
+            std::vector<int32_t> ids(g.memberCnt);
+            if (head[1] != sizeof g + ids.size() * sizeof(int32_t)) { std::cerr << "bad group record" << std::endl; return false; }
+            if (! ids.empty()) memcpy(ids.data(), p + sizeof g, ids.size() * sizeof(int32_t));
+            w.f_group(cur, g, ids.data());
+            break;
+        }
+        case TRACE_ACTION: { RD_PAYLOAD(TraceAction, a); w.action(cur, a); break; }
+        case TRACE_TIME: { RD_PAYLOAD(TraceTime, t); w.time(cur, t); break; }
+        default: break;
+        }
+        #undef RD_PAYLOAD
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3 || (strcmp(argv[2], "csv") == 0 && argc < 4))
+    {
+        std::cerr << "usage : " << argv[0] << " <trace> csv <out_prefix>" << std::endl;
+        std::cerr << "        " << argv[0] << " <trace> json" << std::endl;
+        return 1;
+    }
+    std::ifstream is(argv[1], std::ios::binary);
+    if (! is)
+    {
+        std::cerr << "cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+    if (strcmp(argv[2], "csv") == 0)
+    {
+        CsvWriter w(argv[3]);
+        return read_trace(is, w) ? 0 : 1;
+    }
+    if (strcmp(argv[2], "json") == 0)
+    {
+        JsonWriter w(std::cout);
+        return read_trace(is, w) ? 0 : 1;
+    }
+    std::cerr << "unknown format " << argv[2] << std::endl;
+    return 1;
+}